@@ -1,6 +1,38 @@
 #include <iostream>
 #include <iomanip> 
 #include <string>
+#include <queue>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <new>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#ifndef SCHED_COUNTERS  // Instrumentation counters (--counters) - build with -DSCHED_COUNTERS=0 to compile every counting hook out
+#define SCHED_COUNTERS 1
+#endif
+#ifndef SCHED_SIMD  // Lane-batched Monte Carlo kernel for sweeps - build with -DSCHED_SIMD=0 to simulate everything on the scalar engine
+#define SCHED_SIMD 1
+#endif
+#if SCHED_COUNTERS && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
 using namespace std;
 
 /*
@@ -14,7 +46,7 @@ OS Programming Assignment COP4610
 *To test individual scheduler simulations, see scheduler functions called from main() at the bottom
 
 
-3 CPU Scheduling algorithms
+4 CPU Scheduling algorithms
 Utilizes custom class PCB to manage process
 
 Keeps data private and uses accessor/mutator functions
@@ -27,469 +59,3609 @@ Keeps data private and uses accessor/mutator functions
 
 
 
+thread_local uint64_t allocations = 0;  // Number of allocations made on this thread, for the allocations per event of the benchmarks
+
+__attribute__((noinline)) void* operator new(size_t size) {  // Replaces the global allocator so every allocation is counted - otherwise the same as the default
+    allocations++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL) { throw bad_alloc(); }
+    return p;
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }  // Neither new nor delete is inlined, so the compiler doesn't see free() called on memory from new and warn
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+
+
 class PCB; // Class prototype for PCB (Process Control Block)
-void simulation(string scheduler); // Prototype for simulation function - passes input string scheduler, which could be "SJF", "FCFS", or "MLFQ"
+class EventQueue; // Class prototype for EventQueue (pending simulation events in time order)
+class ReadyHeap; // Class prototype for ReadyHeap (SJF/SRTF ready queue ordered by next CPU burst)
+class MLFQQueues; // Class prototype for MLFQQueues (MLFQ ready queue with one FIFO per priority level)
+class VruntimeTree; // Class prototype for VruntimeTree (CFS/stride ready queue ordered by virtual runtime)
+struct MLFQConfig; // Prototype for MLFQConfig (number of MLFQ levels, their time quanta and the priority boost interval)
+struct PolicyConfig; // Prototype for PolicyConfig (Round Robin quantum, the priorities and aging of priority scheduling, and the nice values and tickets of the fair share schedulers)
+class Workload; // Class prototype for Workload (burst data of every process, built in or memory-mapped from a file)
+struct GeneratorConfig; // Prototype for GeneratorConfig (seed, burst distributions and arrivals of a generated workload)
+class ProcessStream; // Class prototype for ProcessStream (processes of a workload, handed out in arrival order)
+struct ImportConfig; // Prototype for ImportConfig (time unit and split window of an imported Linux scheduler trace)
+class TraceImporter; // Class prototype for TraceImporter (processes rebuilt from a Linux scheduler trace as it is read)
+struct SimulationResult; // Prototype for SimulationResult (total time, CPU utilization and averages of one simulation)
+struct SMPConfig; // Prototype for SMPConfig (number of CPUs, load balancing policy and migration cost)
+struct PCBRecord; // Prototype for PCBRecord (the fields of one PCB, as saved in a snapshot)
+struct Snapshot; // Prototype for Snapshot (the whole state of a simulation at one point in time, to continue from)
+enum OutputLevel { // How much a simulation prints
+    OUTPUT_NONE,     // Nothing (sweep cells, whose results are printed as one table)
+    OUTPUT_RESULTS,  // Only the results table (--quiet)
+    OUTPUT_STEPS     // Every step, then the results table (default)
+};
+SimulationResult runSimulation(string scheduler, const MLFQConfig& mlfq, const PolicyConfig& policies, const SMPConfig& smp, Workload& workload, const GeneratorConfig& generator, OutputLevel output, const Snapshot* from = NULL, int snapshotAt = -1, Snapshot* snapshot = NULL); // Prototype for simulation function - passes input string scheduler, which could be "SJF", "SRTF", "FCFS", "MLFQ", "RR", "PRIO", "CFS" or "STRIDE" - from continues a snapshot instead of starting at t=0, and snapshot is filled in at time snapshotAt instead of finishing
+void printMetrics(const SimulationResult& result); // Prototype for the function printing the averages, percentiles and throughput of a simulation - the end of PCB::printTable, and all of the results when the PCBs were recycled
+
+
+
+enum ProcessState : uint8_t { // States a process goes through - one byte, so checking the state is a single compare
+    UNCREATED,   // Default constructed, not given a process ID and data yet
+    NEW,         // Created, waiting to be admitted
+    READY,       // In a ready queue
+    RUNNING,     // In a CPU
+    WAITING,     // In the waiting list, doing IO
+    TERMINATED   // Finished its last burst
+};
+
+const char* stateName(ProcessState state) { // Name of a state, for messages
+    static const char* names[] = { "", "new", "ready", "running", "waiting", "terminated" };
+    return names[state];
+}
+
+// Tracing: //
+
+enum TraceReason : uint8_t { // Why a process changed state, kept in each trace record
+    TRACE_ARRIVED,          // Admitted to a ready queue (new -> ready)
+    TRACE_DISPATCHED,       // Started running (ready -> running)
+    TRACE_IO_STARTED,       // Finished a CPU burst and started an IO burst (running -> waiting)
+    TRACE_IO_DONE,          // Finished an IO burst (waiting -> ready)
+    TRACE_PREEMPTED,        // Sent back to the ready queue for a process that should run first (running -> ready)
+    TRACE_QUANTUM_EXPIRED,  // Used up its MLFQ time quantum (running -> ready)
+    TRACE_FINISHED,         // Finished its last burst (running -> terminated)
+    TRACE_END               // Last record of a simulation - its time is the total time
+};
+
+struct TraceRecord { // One state change, written to the trace file as it is in memory (20 bytes)
+    int32_t time;      // Simulated time of the change
+    int32_t pid;       // Process ID (0 for TRACE_END)
+    int32_t burst;     // Next CPU burst once ready, time left of the CPU or IO burst once running or waiting, 0 otherwise
+    int16_t cpu;       // CPU the process last ran on (0 if it has not run yet, and in uniprocessor simulations)
+    uint8_t from;      // ProcessState before the change
+    uint8_t to;        // ProcessState after the change
+    uint8_t reason;    // TraceReason of the change
+    uint8_t priority;  // MLFQ priority level after the change
+    uint8_t pad[2];    // Unused
+};
+
+struct TraceHeader { // Comes before the records of each simulation in a trace file - a file holds one header, its records and a TRACE_END record per simulation
+    char magic[8];      // "SCHEDTR1" - marks the start of a simulation
+    uint32_t version;   // Layout of the records (TRACE_VERSION)
+    uint32_t cpus;      // Number of CPUs simulated
+    char scheduler[8];  // Scheduler name, padded with zeros
+};
+
+const char TRACE_MAGIC[8] = { 'S', 'C', 'H', 'E', 'D', 'T', 'R', '1' }; // Magic bytes at the start of every simulation in a trace file
+const uint32_t TRACE_VERSION = 1;  // Version written by TraceWriter
+
+class TraceWriter // Class TraceWriter collects trace records in a large buffer and writes them out a block at a time, so a traced simulation does no I/O per state change
+{
+public:
+    TraceWriter() : buffer(65536) { file = NULL; used = 0; }  // Default constructor - 64K records (1.25MB) are written at a time
+    ~TraceWriter() { close(); }
+    bool open(const char* path);  // Creates the trace file - returns false if it can't be created
+    void begin(string scheduler, int cpus);  // Writes the header of a simulation
+    void record(const TraceRecord& r) { buffer[used++] = r;  if (used == buffer.size()) { flush(); } }  // Adds a record, writing out the buffer once it is full
+    void end(int time);  // Writes the TRACE_END record of a simulation
+    void close();       // Writes out the rest of the buffer and closes the file
+
+private:
+    FILE* file;                  // Trace file (NULL if not open)
+    vector<TraceRecord> buffer;  // Records not written out yet
+    size_t used;                 // Number of records in the buffer
+    void flush();  // Writes out the buffer
+};
+
+thread_local TraceWriter* activeTrace = NULL;  // Trace that simulations on this thread record their state changes in, or NULL when not tracing (then nothing is recorded or written)
+
+bool TraceWriter::open(const char* path) {
+    file = fopen(path, "wb");
+    if (file == NULL) { cout << "Could not create trace file " << path << endl; return false; }
+    return true;
+}
+
+void TraceWriter::begin(string scheduler, int cpus) {
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.cpus = cpus;
+    memcpy(header.scheduler, scheduler.c_str(), min(scheduler.size(), sizeof(header.scheduler)));  // Cut to 8 characters
+    flush();  // Records already buffered go before the header
+    fwrite(&header, sizeof(header), 1, file);
+}
+
+void TraceWriter::end(int time) {
+    TraceRecord r;
+    memset(&r, 0, sizeof(r));
+    r.time = time;  r.reason = TRACE_END;
+    record(r);
+}
 
+void TraceWriter::flush() {
+    if (file != NULL && used > 0) { fwrite(buffer.data(), sizeof(TraceRecord), used, file); }
+    used = 0;
+}
+
+void TraceWriter::close() {
+    if (file == NULL) { return; }
+    flush();
+    fclose(file);
+    file = NULL;
+}
+
+struct RenderProcess { // What the trace renderer knows about one process
+    ProcessState state;  // State after its last record
+    int since;          // Time of its last record
+    int burst;          // Burst of its last record
+    int cpu;            // CPU of its last record
+    long long order;    // Position in the list of its state (records so far when it entered the state)
+};
 
+bool renderTrace(const char* path, string format) { // Prints a trace file to stdout, as the step by step view the schedulers print ("text") or as a Chrome/Perfetto timeline ("chrome")
+    if (format != "text" && format != "chrome") { cout << "Invalid render format " << format << " (use text or chrome)" << endl; return false; }
+    int fd = ::open(path, O_RDONLY);  // Map the file, like a workload - the records are read in place
+    if (fd < 0) { cout << "Could not open trace " << path << endl; return false; }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) { cout << "Trace " << path << " is empty" << endl; ::close(fd); return false; }
+    void* p = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) { cout << "Could not map trace " << path << endl; return false; }
+    const char* data = (const char*)p;
+    size_t size = (size_t)info.st_size, at = 0;  // Size of the file and the offset of the next header or record
+    bool chrome = format == "chrome";
+    bool ok = true;
+    int segment = 0;  // Simulations rendered so far
+    if (chrome) { cout << "{\"traceEvents\":[\n"; }
+    bool first = true;  // No JSON event written yet (no comma needed)
+    auto event = [&]() -> ostream& { if (!first) { cout << ",\n"; } first = false; return cout; };  // Starts the next JSON event
+    while (ok && at < size) {  // Each simulation: a header, its records and a TRACE_END record
+        TraceHeader header;
+        if (size - at < sizeof(header)) { cout << "Trace " << path << " is truncated" << endl; ok = false; break; }
+        memcpy(&header, data + at, sizeof(header));  at += sizeof(header);
+        if (memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header.version != TRACE_VERSION) { cout << "Trace " << path << " is not a version " << TRACE_VERSION << " trace file" << endl; ok = false; break; }
+        string name(header.scheduler, strnlen(header.scheduler, sizeof(header.scheduler)));
+        int cpus = (int)header.cpus;
+        segment++;
+        vector<RenderProcess> procs;      // Indexed by process ID
+        set<pair<long long, int> > lists[TERMINATED + 1];  // Processes in each state, in the order they entered it (order, process ID)
+        long long records = 0;  // Records read so far
+        int arrived = 0;        // Processes admitted so far
+        int stepTime = -1;      // Time of the records being read
+        bool dispatched = false;  // True if a process started running at stepTime
+        auto printStep = [&](int t) {  // The view the scheduler printed after dispatching at time t
+            cout << "\n[" << name;  if (cpus > 1) { cout << " x" << cpus; }  cout << "] Current Execution time: " << t << "\n";
+            vector<int> running(cpus, 0);  // Process running on each CPU (0 = idle)
+            for (auto& e : lists[RUNNING]) { if (procs[e.second].cpu < cpus) { running[procs[e.second].cpu] = e.second; } }
+            for (int c = 0; c < cpus; c++) {
+                if (cpus > 1) { cout << "CPU " << c << ": "; }
+                if (running[c] != 0) { cout << "Running: P" << running[c] << "\n"; } else if (cpus > 1) { cout << "idle\n"; }
+            }
+            if (!lists[READY].empty()) { cout << "Ready:\n"; }
+            for (auto& e : lists[READY]) { cout << "P" << e.second << " [Next CPU burst: " << procs[e.second].burst << "]\n"; }
+            if (!lists[WAITING].empty()) { cout << "Waiting:\n"; }
+            for (auto& e : lists[WAITING]) { cout << "P" << e.second << " [Remaining IO burst: " << procs[e.second].since + procs[e.second].burst - t << "]\n"; }
+            if (!lists[TERMINATED].empty()) { cout << "Terminated:\n"; }
+            for (auto& e : lists[TERMINATED]) { cout << "P" << e.second << " Terminated at time: " << procs[e.second].since << "\n"; }
+        };
+        if (chrome) {  // Name the simulation and its CPU tracks
+            event() << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << segment << ",\"args\":{\"name\":\"" << segment << ": " << name << " x" << cpus << "\"}}";
+            for (int c = 0; c < cpus; c++) { event() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << segment << ",\"tid\":" << c << ",\"args\":{\"name\":\"CPU " << c << "\"}}"; }
+        }
+        while (true) {
+            TraceRecord r;
+            if (size - at < sizeof(r)) { cout << "Trace " << path << " is truncated" << endl; ok = false; break; }
+            memcpy(&r, data + at, sizeof(r));  at += sizeof(r);
+            if (!chrome && r.time != stepTime) {  // Records of a new time - the last time is finished
+                if (dispatched) { printStep(stepTime); }
+                stepTime = r.time;  dispatched = false;
+            }
+            if (r.reason == TRACE_END) {
+                if (!chrome) { cout << "\n" << name << " finished at time " << r.time << " (" << arrived << " processes)\n"; }
+                break;
+            }
+            if (r.pid < 1 || r.to > TERMINATED || r.from > TERMINATED) { cout << "Trace " << path << " has a bad record" << endl; ok = false; break; }
+            if ((size_t)r.pid >= procs.size()) { procs.resize(r.pid + 1, RenderProcess{ NEW, 0, 0, 0, 0 }); }
+            RenderProcess& proc = procs[r.pid];
+            if (chrome && proc.state != NEW && proc.state != r.to) {  // The slice of the state it is leaving
+                if (proc.state == RUNNING) { event() << "{\"name\":\"P" << r.pid << "\",\"ph\":\"X\",\"pid\":" << segment << ",\"tid\":" << proc.cpu << ",\"ts\":" << proc.since << ",\"dur\":" << r.time - proc.since << ",\"args\":{\"burst\":" << proc.burst << "}}"; }
+                else if (proc.state == READY || proc.state == WAITING) { event() << "{\"name\":\"" << (proc.state == READY ? "ready" : "io") << "\",\"ph\":\"X\",\"pid\":" << segment << ",\"tid\":" << cpus + r.pid << ",\"ts\":" << proc.since << ",\"dur\":" << r.time - proc.since << "}"; }
+            }
+            if (chrome && r.reason == TRACE_ARRIVED) { event() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << segment << ",\"tid\":" << cpus + r.pid << ",\"args\":{\"name\":\"P" << r.pid << "\"}}"; }  // Each process gets a track for its ready and io time
+            if (chrome && r.reason == TRACE_PREEMPTED) { event() << "{\"name\":\"preempted\",\"ph\":\"i\",\"s\":\"t\",\"pid\":" << segment << ",\"tid\":" << proc.cpu << ",\"ts\":" << r.time << "}"; }
+            lists[proc.state].erase(make_pair(proc.order, r.pid));  // Out of the list of its old state
+            proc.state = (ProcessState)r.to;  proc.since = r.time;  proc.burst = r.burst;  proc.cpu = r.cpu;  proc.order = records++;
+            lists[proc.state].insert(make_pair(proc.order, r.pid));  // Onto the end of the list of its new state
+            if (r.reason == TRACE_DISPATCHED) { dispatched = true; }
+            if (r.reason == TRACE_ARRIVED) { arrived++; }
+            if (!chrome && r.reason == TRACE_PREEMPTED) { cout << "\nPREEMPTION: time:" << r.time << " Currently running: P" << r.pid << " p" << (int)r.priority << " [" << r.burst << " left]\n"; }
+        }
+    }
+    if (chrome) { cout << "\n],\"displayTimeUnit\":\"ms\"}\n"; }
+    munmap(p, size);
+    return ok;
+}
 
 class PCB // Class PCB to keep track of information for each process - Data members:
 {
 public: // Public data of PCB class includes the accessor and mutator functions of the class
-    PCB* getLast();  // Used to quickly access the end of the list in each state going through the pcbPointers of each PCB
-    PCB* getShortest(); // Used to find the shortest process in the list
-    PCB* getFirstPriority(int ipriority);  // Used to find the first process in list with the input priority, called on head of ready list in mlfq
     PCB* getpcbPointer() { return pcbPointer; }  // Accessor for the pcb pointer var
+    void setpcbPointer(PCB* p) { pcbPointer = p; }  // Mutator for the pcb pointer var
     PCB() { newProcess(); }  // Default value constructor using new process function - is not new state yet (until process ID and data are assigned)
-    PCB(int num, int* array, int arraysize);  // Explicit value constructor assigns process ID and pointer to process data array, setting the process in new state
-    int remainingBurst() { return dataTime - (ioTime + cpuTime); } // Return the difference between the total burst time accumulation and the taken burst time
-    int getLength(); // Get the length of list starting from this PCB and going through the pcbPointers
+    PCB(int num, const int* array, int arraysize);  // Explicit value constructor assigns process ID and pointer to process data array, setting the process in new state
+    int remainingBurst() { return burstLeft; } // Return the time left in the current burst when the process is not running or waiting (0 once the burst is finished)
+    int getBurstEnd() { return burstEnd; }    // Return the time that the current burst finishes at while running or waiting
+    int nextBurst(); // CPU time this process needs when it next runs (the rest of a preempted burst, or else the next burst)
+    int getHeapIndex() { return heapIndex; }  // Accessor for the heap index var
+    void setHeapIndex(int index) { heapIndex = index; }  // Mutator for the heap index var
+    int getCPU() { return cpu; }  // Accessor for the cpu var
+    bool moveToCPU(int icpu, int cost);  // Sets the CPU the process runs on next, adding cost to its burst if it last ran on another CPU - returns true if it migrated
     int getPriority() { return priority; }  // accessor for priority var
+    void setPriority(int ipriority, int quantum) { priority = ipriority; timeQuantum = quantum; }  // mutator for priority var, giving the process the time quantum of its new level
+    int getID() { return processID; }  // accessor for process ID var
+    int burstCount() { return dataSize; }  // accessor for the number of CPU and IO bursts
+    const int* getData() { return processData; }  // accessor for the process data pointer (not for generated processes)
+    void generateBursts(uint64_t random) { generatedBursts = true;  burstRandom = random; }  // Makes this process's bursts with the generator as it reaches them, from this state of its random numbers, instead of reading them from the process data
+    void copyBursts(vector<int>* out);  // Adds every burst of the process to the end of out (to save it in a snapshot)
+    void save(PCBRecord* r);  // Copies the fields of this PCB into a snapshot record
+    void restore(const PCBRecord& r, const int* bursts, PCB** list);  // Sets this PCB up from a snapshot record, with its bursts at the given address, and adds it to the end of list (unless NULL)
+    long long getVruntime(int time);  // Virtual runtime up to the given time - CPU time weighted by 1 / weight, counting the current run if running
+    void setVruntime(long long v) { vruntime = v; }  // Mutator for the vruntime var (when a process is placed in a fair share queue)
+    int getWeight() { return weight; }  // Accessor for the weight var
+    void setWeight(int iweight) { weight = iweight; }  // Mutator for the weight var (nice weight for CFS, tickets for stride)
 
     void newProcess();  // Called by constructor to initialize PCB default values
-    void admitProcess(PCB** ready);  // After Explicit value constructor is called, the process is admitted to the ready queue
-    void runProcess(PCB** ready, PCB** running, int time);  // Runs process from ready state
-    void waitProcess(PCB** running, PCB** waiting);  // Sends the process to waiting list from running state
-    void readyProcess(PCB** waiting, PCB** ready);  // Sends the process to ready queue from waiting state (or running, if substituted waiting pointer with running for mlfq preemption)
+    template <class Queue> void admitProcess(Queue* ready, int time);  // After Explicit value constructor is called, the process is admitted to the ready queue when it arrives (Queue is any ready queue with push and remove)
+    template <class Queue> void runProcess(Queue* ready, PCB** running, int time);  // Runs process from ready state, taking it out of the ready queue
+    void waitProcess(PCB** running, PCB** waiting, int time);  // Sends the process to waiting list from running state
+    template <class Queue> void readyProcess(PCB** waiting, Queue* ready, int time, TraceReason reason);  // Sends the process to the ready queue from waiting state (or running, if substituted waiting pointer with running for preemption) - reason says which, for the trace
     void terminateProcess(PCB** running, PCB** terminated, int time);  // Terminates process from running state
 
-    void cpuManage(PCB** running, PCB** waiting, PCB** terminated, int time);  // Determines whether process in cpu should go to waiting or terminated states if at the end of cpu burst
-    void waitManage(PCB** waiting, PCB** ready);  // Determines whether process in waiting list should go to ready queue
-
-    void waitTiming() { waitingTime++; if (pcbPointer != NULL) { pcbPointer->waitTiming(); } }
-    void cpuTiming() { cpuTime++; if (pcbPointer != NULL) { pcbPointer->cpuTiming(); } }
-    void ioTiming() { ioTime++; if (pcbPointer != NULL) { pcbPointer->ioTiming(); } }
+    void cpuManage(PCB** running, PCB** waiting, PCB** terminated, int time, EventQueue* events);  // Determines whether process in cpu should go to waiting or terminated states if at the end of cpu burst
+    template <class Queue> bool waitManage(PCB** waiting, Queue* ready, int time);  // Determines whether process in waiting list should go to ready queue (called when its I/O completion event fires) - returns true if it went
 
-    void printStatus(); // Prints the status of process to indicate its progress in CPU, IO, Ready queue, or termination
-    void printTable(PCB* head, int id); // Prints the final values in each process, in order P1 to Px (Called recursively uusing head pointer to scan for numeric order in terminated list)
+    void printStatus(int time); // Prints the status of process to indicate its progress in CPU, IO, Ready queue, or termination at the given time (and of every process after it in its list)
+    void printOne(int time);    // Prints the status of this process only
+    void printTable(const SimulationResult& result); // Prints the final values in each process of the list starting from this PCB (the terminated list), in order P1 to Px, then the averages, percentiles and throughput of the simulation
 
-    void incrementPC();  // Increments the time variables for io, cpu, and waiting times
-    void decrementTQ() { timeQuantum--; }  // Decrements the time quantum var by 1
+    void incrementPC();  // Moves on to the next burst in the process data
+    void startQuantum(int time) { quantumEnd = time + timeQuantum; }  // Starts the time quantum running at the given time
+    void startQuantum(int time, int quantum) { timeQuantum = quantum;  quantumEnd = time + quantum; }  // Starts a time quantum of the given length (a CFS or stride slice)
+    int getQuantumEnd() { return quantumEnd; }  // Accessor for the quantum end var
+    int getQuantum() { return timeQuantum; }    // Accessor for the time quantum var
 
-    void cpuManageMLFQ(PCB** ready, PCB** running, PCB** waiting, PCB** terminated, int time); // Separate CPU manage function called by MLFQ scheduler for preemption with higher priority process
+    void cpuManageMLFQ(MLFQQueues* ready, PCB** running, PCB** waiting, PCB** terminated, int time, EventQueue* events, const MLFQConfig& config); // Separate CPU manage function called by MLFQ scheduler, which also moves the process down a level when its time quantum runs out
     
 
 private: // Private data of PCB class includes the variables holding information to each process
-    string processState; // Keep track of which state this process should be in
+    ProcessState processState; // Keep track of which state this process should be in
+    uint8_t priority;   // Current priority of the process, to be initialized in a new process at 1, and goes up to the number of MLFQ levels (3 by default, 64 at most)
+    bool generatedBursts;  // True if the bursts are made by the generator as they are reached (burstRandom), false if they are read from processData
     int processID;      // Keep track of process number (P1-8)
     PCB* pcbPointer;   // Pointer to next PCB - Used in each state to keep track of the order of PCBs
-    int* processData; // Pointer to the first CPU burst of the process data (CPU and IO burst) array
+    PCB* prevPointer; // Pointer to the previous PCB in a list - the head of a list points back to the tail, so adding to the end and taking out from anywhere are O(1)
+    union {
+        const int* processData; // Pointer to the first CPU burst of the process data (CPU and IO burst) array - may point straight into a memory-mapped workload file
+        uint64_t burstRandom;   // or, for a generated process, the state of its random numbers once the bursts up to dataIndex are drawn - nothing per burst is stored
+    };
     int dataSize;    // A variable saved with the process data to remember the size of its array
     int dataIndex;  // Keep track of which burst the process is on starting with 0
-    int dataTime;  // The total ammount of accumulated burst time including cpu and io
-    int waitingTime;         // Accumulate 1 for every time unit spent in waiting queue
-    int cpuTime;            // Accumulate 1 for every time unit spent in CPU
-    int ioTime;            // Accumulate 1 for every time unit spent in I/O
-    int responseTime;     // Record the first time of execution in each process
-    int terminationTime; // Record the time that the process is terminated
-    int priority;       // Current priority of the process, to be initialized in a new process at 1, and goes up to 3
+    int burstLeft; // Time left in the current burst, saved when the process stops running (0 once the burst is finished)
+    int burstEnd; // Time that the current CPU or IO burst finishes at, set when the process starts running or waiting
+    int stateSince;          // Time that the process entered its current state (the time of termination, once terminated)
+    int waitingTime;         // Accumulate the time spent in waiting queue, added when the process leaves the ready state (the CPU and IO time are the rest of the turnaround, from arrivalTime to stateSince)
+    long long vruntime;   // Virtual runtime - CPU time scaled by VRUNTIME_SCALE / weight, added when the process leaves the running state (the CFS vruntime, or the stride pass)
+    int weight;          // Share of the CPU the process gets under CFS (from its nice value) or stride scheduling (its tickets)
+    int arrivalTime;     // Time that the process arrived and was admitted
+    int responseTime;   // Record the time from arrival to first execution in each process
     int timeQuantum;   // Current tq of the process, to be initialized in a new process at 5
+    int quantumEnd;   // Time that the time quantum runs out at, set when the process starts running
+    int heapIndex;    // Position of this process in the SJF/SRTF ready heap (or its node in the CFS/stride tree), or -1 if not in either
+    int cpu;         // CPU the process last ran on (SMP simulations), or -1 if it has not run yet
+
+    void appendTo(PCB** list);    // Adds this PCB to the end of the list starting at *list
+    void unlinkFrom(PCB** list);  // Takes this PCB out of the list starting at *list, mending the list around it
+    void accountTo(int time);  // Adds the time spent in the current state up to the given time onto its waiting time or vruntime
+    void trace(ProcessState from, int time, TraceReason reason);  // Records the state change just made, if tracing, and counts it, if counting
+    void traceRecord(ProcessState from, int time, TraceReason reason);  // Adds the trace record of a state change
+};
+
+
+
+enum EventType { // Kinds of events that can change the state of the simulation
+    ARRIVAL,         // A process arrives and is admitted to the ready queue
+    IO_COMPLETE,     // A process in the waiting list finishes its I/O burst
+    BURST_COMPLETE,  // The running process finishes its CPU burst
+    QUANTUM_EXPIRE,  // The running process uses up its MLFQ time quantum
+    PRIORITY_BOOST,  // Every MLFQ process goes back to the top priority level
+    BALANCE          // SMP push migration moves processes from busy CPUs to idle ones
+};
+
+struct Event { // One point in simulated time at which something may change
+    int time;        // Simulated time that the event happens at
+    long long seq;   // Order the event was scheduled in, so events at the same time keep first come first serve order
+    EventType type;  // Which kind of event this is
+    PCB* pcb;        // The process that the event belongs to
+    bool operator>(const Event& e) const { return time > e.time || (time == e.time && seq > e.seq); } // Later time (or same time but scheduled later) comes out of the queue after
+};
+
+class EventQueue // Class EventQueue holds the pending events in time order, so the schedulers can jump straight from one event to the next instead of stepping every time unit
+{
+public:
+    EventQueue() { scheduled = 0; }  // Default constructor starts with no events
+    void schedule(int time, EventType type, PCB* pcb) { events.push(Event{ time, scheduled++, type, pcb }); } // Adds an event to the queue
+    bool empty() { return events.empty(); }    // Returns true if there are no pending events
+    int nextTime() { return events.top().time; }  // Time of the earliest pending event (queue must not be empty)
+    Event pop() { Event e = events.top(); events.pop(); return e; }  // Removes and returns the earliest pending event
+    long long count() { return scheduled; }  // Number of events scheduled so far
+    void setCount(long long n) { scheduled = n; }  // Carries the count on from a snapshot (n must be at least the number of events scheduled since the queue was made)
+    vector<Event> pending();  // Every pending event, in the order they will come out
+
+private:
+    priority_queue<Event, vector<Event>, greater<Event>> events; // Min-heap of events ordered by time, then by order scheduled
+    long long scheduled; // Count of events scheduled so far, used as the tie-breaker sequence number
+};
+
+class ReadyHeap // Class ReadyHeap is the ready queue for SJF and SRTF - a binary min-heap of PCBs keyed on the CPU time they need next, so picking the shortest job is O(log n) (or keyed on priority, for priority scheduling)
+{
+public:
+    ReadyHeap(bool priorityKeys = false) { pushed = 0; byPriority = priorityKeys; }  // Default constructor starts with an empty heap keyed on next CPU burst - priorityKeys keys it on priority instead
+    bool empty() { return entries.empty(); }  // Returns true if no process is ready
+    int size() { return (int)entries.size(); }  // Number of ready processes
+    PCB* top() { return entries[0].pcb; }      // The ready process with the shortest next CPU burst (heap must not be empty)
+    int topKey() { return entries[0].key; }   // The next CPU burst of that process
+    PCB* at(int i) { return entries[i].pcb; } // The process in slot i (0 to size() - 1), to go through every ready process
+
+    void push(PCB* pcb);   // Inserts a process keyed on its next CPU burst
+    void remove(PCB* pcb); // Takes a process out of the heap from wherever it is (the top, when it is dispatched)
+    void decreaseKey(PCB* pcb, int key);  // Lowers the key of a process already in the heap and moves it up to its new place
+    void printStatus(int time);  // Prints every process in the heap (in heap order)
+    void collect(vector<PCB*>* out);  // Adds every process to out in the order they were pushed, so pushing them back in that order gives the same queue
+
+private:
+    struct Entry { // One heap slot - the key is kept next to the pointer so comparisons never have to touch the PCB
+        int key;        // Next CPU burst of the process
+        long long seq;  // Order the process was pushed in - equal bursts are served first come first serve, like the old list scan
+        PCB* pcb;       // The ready process
+    };
+    bool before(int a, int b) { return entries[a].key < entries[b].key || (entries[a].key == entries[b].key && entries[a].seq < entries[b].seq); } // True if slot a should come out before slot b
+    void swapEntries(int a, int b);  // Swaps two slots and updates the heap index saved in each PCB
+    void siftUp(int i);    // Moves the entry at slot i up until its parent comes before it
+    void siftDown(int i);  // Moves the entry at slot i down until it comes before both children
+
+    vector<Entry> entries; // Heap array - children of slot i are at 2i+1 and 2i+2
+    long long pushed;     // Count of pushes so far, used as the tie-breaker sequence number
+    bool byPriority;     // True if keyed on priority rather than next CPU burst
+};
+
+const int NICE_0_WEIGHT = 1024;  // Weight of a nice 0 process
+const long long VRUNTIME_SCALE = 1 << 20;  // A process's vruntime goes up by VRUNTIME_SCALE / weight for each time unit it runs
+const long long VRUNTIME_UNIT = VRUNTIME_SCALE / NICE_0_WEIGHT;  // vruntime of one time unit at nice 0
+
+int niceWeight(int nice) { // Weight of a nice value (-20 to 19) - the Linux table, each step is about 1.25x, so one nice level is about 10% of the CPU
+    static const int weights[40] = {
+        88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,  // -20 to -11
+        9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,           // -10 to -1
+        1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,                   // 0 to 9
+        110, 87, 70, 56, 45, 36, 29, 23, 18, 15 };                          // 10 to 19
+    return weights[nice + 20];
+}
+
+class VruntimeTree // Class VruntimeTree is the ready queue for CFS and stride scheduling - a red-black tree of PCBs keyed on vruntime, with the leftmost node cached, so picking the next process is O(1) and inserting or removing one is O(log n)
+{
+public:
+    VruntimeTree(long long credit = 0);  // Starts with an empty tree - credit is how far behind the minimum vruntime a woken process may be placed
+    bool empty() { return count == 0; }  // Returns true if no process is ready
+    int size() { return count; }        // Number of ready processes
+    PCB* first() { return nodes[leftmost].pcb; }  // The ready process with the lowest vruntime (tree must not be empty)
+    long long firstKey() { return nodes[leftmost].key; }  // The vruntime of that process
+    long long minVruntime() { return minKey; }  // Lowest vruntime in the queue so far - only ever goes up, and new processes start at it
+    long long totalWeight() { return weights; } // Sum of the weights of the ready processes
+
+    void push(PCB* pcb);   // Inserts a process keyed on its vruntime, moving the vruntime up to the minimum less the credit first if it is further behind
+    void wake(PCB* pcb);   // Marks a process just pushed as woken (it arrived or finished its IO), so it may preempt the running one
+    void remove(PCB* pcb); // Takes a process out of the tree from wherever it is (the leftmost, when it is dispatched)
+    void advance(long long v);  // Moves the minimum vruntime up to v (the vruntime of a running process), or to the leftmost if that is lower
+    long long takeWoken();  // Lowest vruntime of a woken process pushed since the last call (INT64_MAX if none) - what a woken process preempts with
+    void setMinVruntime(long long v) { minKey = v; }  // Mutator for the minimum vruntime, to carry on from a snapshot
+    long long getWoken() { return woken; }         // Accessor for the woken var, to save it in a snapshot
+    void setWoken(long long v) { woken = v; }     // Mutator for the woken var, to carry on from a snapshot
+    void printStatus(int time);  // Prints every process in the tree, lowest vruntime first
+    void collect(vector<PCB*>* out);  // Adds every process to out, lowest vruntime first
+
+private:
+    struct Node { // One tree node - kept in a vector and linked by index, so nodes are reused instead of allocated per push (index 0 is the black nil node)
+        long long key;   // vruntime of the process when it was pushed
+        long long seq;   // Order the process was pushed in - equal vruntimes are served first come first serve
+        PCB* pcb;        // The ready process (NULL for a free node)
+        int left, right, parent;  // Linked nodes (0 = none) - free nodes are chained through right
+        bool red;        // Colour of the node
+    };
+    bool before(int a, int b) { return nodes[a].key < nodes[b].key || (nodes[a].key == nodes[b].key && nodes[a].seq < nodes[b].seq); } // True if node a comes out before node b
+    int minimum(int x) { while (nodes[x].left != 0) { x = nodes[x].left; } return x; }  // Leftmost node under x
+    void rotateLeft(int x);   // Makes x the left child of its right child
+    void rotateRight(int x);  // Makes x the right child of its left child
+    void transplant(int u, int v);  // Puts the subtree at v where the subtree at u was
+    void insertFixup(int z);  // Recolours and rotates after inserting z, so no red node has a red child
+    void deleteFixup(int x);  // Recolours and rotates after taking out a black node, so every path has the same number of black nodes
+
+    vector<Node> nodes;  // Every node, in use or free
+    int root;           // Root node (0 = empty tree)
+    int leftmost;      // Node with the lowest vruntime, cached so picking is O(1)
+    int freeNodes;    // First free node (0 = none)
+    int count;       // Number of ready processes
+    long long pushed;   // Count of pushes so far, used as the tie-breaker sequence number
+    long long minKey;   // Minimum vruntime (see minVruntime)
+    long long credit;   // How far behind minKey a woken process may be placed
+    long long weights;  // Sum of the ready weights
+    long long woken;    // Lowest vruntime of a woken process pushed since takeWoken was last called
+};
+
+struct MLFQConfig { // Runtime parameters of the MLFQ scheduler
+    int levels;          // Number of priority levels (1 to 64) - priority 1 is the highest
+    vector<int> quanta;  // Time quantum of each level, top level first - 0 means the process runs until its burst ends
+    int boostInterval;   // Every boostInterval time units all processes go back to priority 1 (0 = never)
+};
+
+struct PolicyConfig { // Runtime parameters of the Round Robin, priority, CFS and stride schedulers
+    int rrQuantum;       // Round Robin time quantum (and the stride scheduling quantum)
+    int priorityLevels;  // Number of priorities (1 to 64) - priority 1 is the highest
+    int agingInterval;   // Every agingInterval time units each ready process goes up a priority (0 = never)
+    vector<int> nice;    // CFS nice values (-20 to 19) - process Pn gets nice[(n - 1) mod size]
+    int cfsLatency;      // CFS scheduling period - every ready process should run within it
+    int cfsGranularity;  // Shortest CFS slice, and how far ahead in vruntime (in nice 0 time units) the running process must be for a woken process to preempt it
+    vector<int> tickets; // Stride scheduling tickets - process Pn gets tickets[(n - 1) mod size]
+};
+
+class MLFQQueues // Class MLFQQueues is the ready queue for MLFQ - one first come first serve list per priority level, plus a bitmask of which levels have processes, so picking the next process is O(1)
+{
+public:
+    MLFQQueues(int levels, int quantum) : heads(levels, NULL), tails(levels, NULL) { nonEmpty = 0; count = 0; topQuantum = quantum; } // Starts with every level empty (quantum is the time quantum of the top level)
+    bool empty() { return nonEmpty == 0; }  // Returns true if no process is ready
+    int size() { return count; }           // Number of ready processes
+    int highestLevel() { return __builtin_ctzll(nonEmpty); }  // Highest priority level (0 = priority 1) with a ready process - lowest set bit of the mask (queue must not be empty)
+    PCB* first() { return heads[highestLevel()]; }  // First process in the highest non-empty level - the one MLFQ runs next
+    int getTopQuantum() { return topQuantum; }     // Time quantum that new processes start with
+
+    void push(PCB* pcb);   // Adds a process to the end of the level for its priority
+    void remove(PCB* pcb); // Takes a process out of its level (the head, when it is dispatched)
+    void boost(int quantum);  // Moves every ready process up to the top level (priority 1), keeping their order
+    void printStatus(int time);  // Prints every ready process, highest level first
+    void collect(vector<PCB*>* out);  // Adds every ready process to out, highest level first and in order within each level
+
+private:
+    vector<PCB*> heads;  // First process of each level (linked through the pcbPointers)
+    vector<PCB*> tails;  // Last process of each level, so adding to a level is O(1)
+    uint64_t nonEmpty;  // Bit i is set if level i has a ready process
+    int count;         // Number of ready processes
+    int topQuantum;   // Time quantum of the top level
+};
+
+class Histogram // Class Histogram counts values in log-linear buckets (HDR style) - values below 64 get a bucket each, and every power of two above that is split into 32 buckets, so percentiles are within 3% using a fixed 864 buckets however many values are added
+{
+public:
+    Histogram() : counts(BUCKETS, 0) { total = 0; sum = 0; maxValue = 0; }  // Default constructor starts empty
+    void add(int value) { if (value < 0) { value = 0; } counts[bucketOf(value)]++; total++; sum += value; if (value > maxValue) { maxValue = value; } }  // Counts a value - O(1)
+    void add(int value, uint64_t times) { if (value < 0) { value = 0; } counts[bucketOf(value)] += times; total += times; sum += (int64_t)value * times; if (times > 0 && value > maxValue) { maxValue = value; } }  // Counts a value the given number of times - O(1)
+    void merge(const Histogram& h);  // Adds the counts of another histogram, as if its values had been added to this one
+    uint64_t count() const { return total; }  // Number of values added
+    double mean() const { return total > 0 ? (double)sum / total : 0; }  // Exact mean of the values
+    int max() const { return maxValue; }  // Largest value added (0 if none)
+    int64_t valueSum() const { return sum; }  // Total of the values added
+    int percentile(double p) const;  // Value that p percent of the values are at or below - the top of the bucket it falls in, so never below the exact value
+    bool write(FILE* out) const;  // Writes the histogram to a snapshot file, returning false if it could not
+    bool read(FILE* in);         // Reads a histogram written by write(), returning false if it could not
+
+private:
+    static const int BUCKETS = 64 + 25 * 32;  // Exact buckets for 0 - 63, then 32 per power of two up to 2^31
+    static int bucketOf(int value) {  // Bucket a value is counted in
+        if (value < 64) { return value; }
+        int top = 31 - __builtin_clz(value);  // Highest set bit (6 or more)
+        return 64 + (top - 6) * 32 + ((value >> (top - 5)) - 32);  // The 5 bits below the top bit pick the bucket within its power of two
+    }
+    static int highestIn(int bucket) {  // Largest value counted in a bucket
+        if (bucket < 64) { return bucket; }
+        int shift = (bucket - 64) / 32 + 1;  // Values in the bucket share all but their lowest shift bits
+        return (int)((((int64_t)32 + (bucket - 64) % 32) << shift) + ((int64_t)1 << shift) - 1);
+    }
+
+    vector<uint64_t> counts;  // Number of values in each bucket
+    uint64_t total;          // Number of values
+    int64_t sum;            // Total of the values, for the mean
+    int maxValue;          // Largest value
+};
+
+struct Metrics { // Times of every process that terminated in a simulation, counted as each one terminates so there is no pass over the processes at the end
+    Histogram waiting;     // Waiting time (Tw) - time spent in a ready queue
+    Histogram turnaround;  // Turnaround time (Ttr) - arrival to termination
+    Histogram response;    // Response time (Tr) - arrival to first run
+    uint64_t dispatches = 0;  // Number of times a process was started running (scheduling decisions)
+    void merge(const Metrics& m) { waiting.merge(m.waiting);  turnaround.merge(m.turnaround);  response.merge(m.response);  dispatches += m.dispatches; }  // Adds the processes of another simulation
+};
+
+thread_local Metrics* activeMetrics = NULL;  // Metrics that processes terminating on this thread are counted in, or NULL when not counting
+
+#if SCHED_COUNTERS
+inline uint64_t cycles() {  // Time stamp counter ticks on x86, or else steady clock nanoseconds - for timing scheduling decisions
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct QueueSample { // Queue lengths at one point in time
+    int time;     // Simulated time
+    int ready;    // Ready processes
+    int waiting;  // Processes doing IO
+};
+
+struct Counters { // Instrumentation counters of one simulation (--counters) - each simulation counts into its own result on its own thread, so parallel sweep simulations never share them
+    uint64_t transitions[TRACE_END] = {};  // State changes by reason - the preempted and quantum expired ones are the preemptions, by cause
+    uint64_t contextSwitches = 0;  // Dispatches of a different process to the one the CPU ran last
+    uint64_t demotions = 0;        // MLFQ processes moved down a level for using up their quantum
+    uint64_t periodic = 0;         // Runs of the policy's periodic work (MLFQ boosts, priority aging)
+    int inState[TERMINATED + 1] = {};  // Processes in each state now
+    Histogram readyLength;     // Ready processes, counted once per time unit
+    Histogram ioDepth;         // Processes doing IO, counted once per time unit
+    Histogram decisionCycles;  // Ticks from picking a process to it running, once per dispatch
+    vector<QueueSample> series;  // Queue lengths every seriesInterval time units - when it fills, every other sample is dropped and the interval doubles, so it stays small however long the simulation runs
+    int seriesInterval = 1;
+    long long nextSample = 0;   // Time of the next sample
+    vector<int> lastProcess;    // Process each CPU ran last (0 = none)
+    uint64_t decisionStart = 0; // Ticks when the current decision started
+    static const size_t SERIES_MAX = 1024;  // Samples kept at most
+
+    void begin(int cpus, int time) { lastProcess.assign(cpus, 0);  nextSample = time; }  // Called when a simulation starts (or carries on from a snapshot) at the given time
+    void transition(ProcessState from, ProcessState to, TraceReason reason) { transitions[reason]++;  if (from != NEW) { inState[from]--; }  inState[to]++; }
+    void startDecision() { decisionStart = cycles(); }
+    void dispatched(int cpu, int pid) {  // Called once the picked process is running
+        decisionCycles.add((int)min(cycles() - decisionStart, (uint64_t)INT32_MAX));
+        if (lastProcess[cpu] != pid) { contextSwitches++;  lastProcess[cpu] = pid; }
+    }
+    void elapse(int time, int units);  // Counts the queue lengths over the time units from time on (nothing changes in between)
+};
+
+void Counters::elapse(int time, int units) {
+    readyLength.add(inState[READY], units);
+    ioDepth.add(inState[WAITING], units);
+    for (; nextSample < (long long)time + units; nextSample += seriesInterval) {
+        if (series.size() == SERIES_MAX) {  // Keep the even samples - the next sample is an even one too, so it stays on the doubled interval
+            for (size_t i = 0; i < SERIES_MAX / 2; i++) { series[i] = series[2 * i]; }
+            series.resize(SERIES_MAX / 2);
+            seriesInterval *= 2;
+        }
+        series.push_back(QueueSample{ (int)nextSample, inState[READY], inState[WAITING] });
+    }
+}
+
+thread_local Counters* activeCounters = NULL;  // Counters of the simulation running on this thread, or NULL when not counting
+bool counting = false;  // True if --counters was given, so every simulation counts (set once, before any simulation starts)
+#define COUNT(statement) do { if (activeCounters != NULL) { activeCounters->statement; } } while (0)  // Runs a counting statement, if counting
+#else
+#define COUNT(statement) do { } while (0)  // Compiled out
+#endif
+
+void Histogram::merge(const Histogram& h) {
+    for (int i = 0; i < BUCKETS; i++) { counts[i] += h.counts[i]; }
+    total += h.total;  sum += h.sum;
+    if (h.maxValue > maxValue) { maxValue = h.maxValue; }
+}
+
+bool Histogram::write(FILE* out) const {  // Count, sum and largest value, then every bucket
+    int64_t header[3] = { (int64_t)total, sum, maxValue };
+    return fwrite(header, sizeof(header), 1, out) == 1 && fwrite(counts.data(), sizeof(uint64_t), BUCKETS, out) == (size_t)BUCKETS;
+}
+
+bool Histogram::read(FILE* in) {
+    int64_t header[3];
+    if (fread(header, sizeof(header), 1, in) != 1 || fread(counts.data(), sizeof(uint64_t), BUCKETS, in) != (size_t)BUCKETS) { return false; }
+    total = (uint64_t)header[0];  sum = header[1];  maxValue = (int)header[2];
+    return true;
+}
+
+int Histogram::percentile(double p) const {
+    if (total == 0) { return 0; }
+    uint64_t rank = (uint64_t)ceil(p / 100 * total);  // Number of values at or below the percentile
+    if (rank < 1) { rank = 1; }
+    uint64_t seen = 0;  // Values in the buckets so far
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) { return highestIn(i) < maxValue ? highestIn(i) : maxValue; }  // The top of the bucket, but no more than the largest value
+    }
+    return maxValue;
+}
+
+struct SimulationResult { // Outcome of one simulation, for the results, the sweep table and the summary
+    int totalTime;    // Time the last process terminated (-1 if the simulation did not finish)
+    int idleTime;     // Time the CPUs spent with nothing running, all CPUs together
+    int cpus;         // Number of CPUs simulated
+    int migrations;   // Number of times a process ran on a different CPU to the last time
+    long long events; // Number of events the simulation scheduled
+    Metrics metrics;  // Waiting, turnaround and response times of the processes that terminated
+#if SCHED_COUNTERS
+    Counters counters;  // Instrumentation counters (only counted with --counters)
+#endif
+};
+
+enum BalancePolicy { // How an SMP simulation spreads processes over the CPUs
+    BALANCE_GLOBAL,  // One ready queue shared by every CPU
+    BALANCE_PUSH,    // A ready queue per CPU, and every balance interval processes are pushed from the busiest CPUs to the idlest
+    BALANCE_STEAL    // A ready queue per CPU, and a CPU with nothing to run steals a process from the busiest CPU
+};
+
+struct SMPConfig { // Runtime parameters of SMP simulations
+    int cpus;              // Number of CPUs (1 = the original uniprocessor simulation)
+    BalancePolicy balance; // How processes are spread over the CPUs
+    int balanceInterval;   // Time between push migrations (BALANCE_PUSH)
+    int migrationCost;     // Time added to a burst that runs on a different CPU to the last one
+};
+
+enum SnapshotPlace { // Where a process is in a snapshot
+    PLACE_READY,      // In a ready queue (in the order it would be picked)
+    PLACE_RUNNING,    // Running on a CPU
+    PLACE_WAITING,    // In the waiting list (in list order)
+    PLACE_TERMINATED  // In the terminated list (in list order)
+};
+
+struct PCBRecord { // One process in a snapshot, written to the snapshot file as it is in memory - every PCB field but the list links, burst pointer and heap slot, which are rebuilt when it is restored
+    int64_t vruntime;
+    int32_t processID, dataSize, dataIndex, burstLeft, burstEnd, stateSince, waitingTime, arrivalTime, responseTime, timeQuantum, quantumEnd, cpu, weight;
+    int32_t queue;     // Ready queue (PLACE_READY) or CPU (PLACE_RUNNING) the process is in
+    uint8_t state;     // ProcessState
+    uint8_t priority;
+    uint8_t place;     // SnapshotPlace
+    uint8_t pad[5];    // Always 0 - keeps the record a multiple of 8 bytes with no unwritten padding
+};
+
+struct SnapshotEvent { // One pending event in a snapshot
+    int32_t time;
+    int32_t type;  // EventType
+    int32_t pcb;   // Index of its process in the snapshot's records (-1 for none, or for a process that has since been recycled)
 };
 
+struct Snapshot { // Everything a simulation needs to carry on from one point in time, in a form any policy can continue from - the clock, every process and where it is, the pending events, the arrivals to come and the metrics so far
+    string scheduler;       // Scheduler the simulation ran under until now
+    int time;               // Clock - the simulation carries on from the first event at or after this time (-1 = no snapshot, every process finished first)
+    int cpus;               // Number of CPUs
+    int migrations;         // Migrations so far
+    long long eventCount;   // Events scheduled so far
+    bool recycled;          // True if terminated PCBs were recycled (so the terminated list is not complete)
+    uint64_t seed;          // Seed of the generated workload (0 for a workload file or the sample)
+    int workloadProcesses;  // Number of processes in the whole workload - with the seed, checks a restore is given the same workload
+    int created;            // Processes created so far
+    int generatorMade;      // How far the generator had got (generated workloads only)
+    int generatorArrival;
+    uint64_t generatorRandom;
+    vector<int> idleTime;           // Idle time of each CPU
+    vector<long long> queueState;  // Policy state of the ready queues (for CFS and stride, the minimum vruntime and lowest woken vruntime of each)
+    vector<PCBRecord> processes;    // Every process that has arrived and not been recycled
+    vector<int> bursts;             // Their bursts, one process after another
+    vector<SnapshotEvent> events;   // Pending events in order (but not the periodic policy work, which restarts from the clock)
+    Metrics metrics;                // Processes that terminated so far
 
+    Snapshot() { time = -1; cpus = 0; migrations = 0; eventCount = 0; recycled = false; seed = 0; workloadProcesses = 0; created = 0; generatorMade = 0; generatorArrival = 0; generatorRandom = 0; }
+    bool save(string path) const;  // Writes the snapshot to a file, returning false (with a message) if it can't
+    bool load(string path);       // Reads a snapshot file, returning false (with a message) if it can't be used
+};
+
+
+
+inline void PCB::trace(ProcessState from, int time, TraceReason reason) {  // Defined out of the class so it can reach the counters
+    if (activeTrace != NULL) { traceRecord(from, time, reason); }
+    COUNT(transition(from, processState, reason));
+}
 
 void PCB::newProcess() {     // Called in constructor to initialize variables to default values
     pcbPointer = NULL;      // Initialize pointer as null
-    waitingTime = 0;       // Accumulate 1 for every time unit spent in waiting queue
-    cpuTime = 0;          // Accumulate 1 for every time unit spent in CPU
-    ioTime = 0;          // Accumulate 1 for every time unit spent in I/O
+    prevPointer = NULL;    // Not in a list
+    waitingTime = 0;       // Accumulates the time spent in waiting queue
+    generatedBursts = false;  // Bursts are read from the process data unless generateBursts() is called
+    vruntime = 0;       // Set when the process is placed in a fair share queue
+    weight = NICE_0_WEIGHT;  // Nice 0 unless a fair share policy says otherwise
     dataIndex = -1;     // Start program counter at -1 since execution hasn't yet started (sets to 0 when start, then increments)
-    dataTime = 0;      // Start the total time at 0 before accumulating
+    burstLeft = 0;     // No burst started yet
+    burstEnd = 0;     // Set when the first burst starts
+    stateSince = 0;  // Set when the process is admitted
+    quantumEnd = 0; // Set when the process first runs
     priority = 1;     // Start priority at 1 (highest) before potential lowering
+    heapIndex = -1;  // Not in the ready heap yet
+    cpu = -1;       // Has not run on any CPU yet
     timeQuantum = 5; // Start time quantum at 5 for priority 1 - decrements over time in cpu
+    arrivalTime = 0;       // Arrival time is set when the process is admitted
     responseTime = -1;  // Start response time at -1 to indicate that it has not been set yet - upon first execution of the process this will be set to the time of execution start
-    processState = ""; // Start process state at "" (empty string) to indicate that it has not been fully created yet - upon being given a processID and data, it can be a new process
+    processState = UNCREATED; // Start process state at UNCREATED to indicate that it has not been fully created yet - upon being given a processID and data, it can be a new process
 }
 
-PCB::PCB(int num, int* array, int arraysize) {
+PCB::PCB(int num, const int* array, int arraysize) {
     newProcess();             // Initialize process with program counter = 0
-    processState = "new";    // Initialize a process in new state
+    processState = NEW;      // Initialize a process in new state
     processID = num;        // Initialize process with given process ID (P1-8)
     processData = array;   // Assign the input array to the data pointer
     dataSize = arraysize; // Keep the passed function argument of array size as var
 }
 
-PCB* PCB::getLast() { // Calls recursively on itself to return the very last PCB pointer in a list, calling first on the head of list
-    if (pcbPointer == NULL) { return this; } // If at the last PCB of the list, the next pointer will be null (and if the list is only 1 PCB)
-    else { return pcbPointer->getLast(); }  // Otherwise call recursively on the next PCB pointer, eventually returning the last one all the way back
+template <class Queue>
+void PCB::admitProcess(Queue* ready, int time) { // Used to admit processes in the new state into the ready state when they arrive (the policy sets up anything else the queue keys on first, like the MLFQ level or the vruntime)
+    if (processState == NEW) {  // Process must be new to be admitted
+        processState = READY;  // Set the current process state to ready
+        stateSince = time;      // Waiting time starts counting from the time of admission
+        arrivalTime = time;    // Response time is measured from arrival
+        ready->push(this);    // Add it to the ready queue
+        trace(NEW, time, TRACE_ARRIVED);
+    }
+    else { cout << "Could not admit process " << processID << " - [" << stateName(processState) << "]" << endl; } // Print error message
 }
 
-PCB* PCB::getShortest() {  // Used for SJF scheduling to find the shortest job in the ready queue, by calling recursively starting with the head of the list
-    if (pcbPointer == NULL) { return this; }  // If the next PCB pointer is NULL, which means the end of the list, (or list is only 1 PCB) return the current PCB
-    else {  // Otherwise compare the next PCB pointer's next CPU burst to the current PCB's next CPU burst which is found through the processData array and using the index+1 for next burst
-        if (pcbPointer->getShortest()->processData[pcbPointer->getShortest()->dataIndex + 1] < processData[dataIndex + 1]) { return pcbPointer->getShortest(); }
-        else { return this; }  // If the current PCB's CPU burst is greater than or equal to the next (lower) PCB's CPU burst, return this pointer
-    }
+template <class Queue>
+void PCB::runProcess(Queue* ready, PCB** running, int time) {  // moves process from the ready queue to running (the policy starts its quantum or slice, if it has one)
+    if (processState == READY) {  // First check if process is in ready state (process can only go into running state from ready)
+        accountTo(time);          // Add the time spent in the ready queue to the waiting time
+        processState = RUNNING;  // Set current process state to running
+        burstEnd = time + burstLeft; // The (rest of the) CPU burst finishes this long from now
+        ready->remove(this);      // Take this PCB out of the ready queue
+        appendTo(running);       // Set the running pointer to the current PCB (there is only 1 process running at a time, so it is a list of one)
+        if (responseTime == -1) { responseTime = time - arrivalTime; } // set response time when process is ran (if first time -1)
+        trace(READY, time, TRACE_DISPATCHED);
+        if (activeMetrics != NULL) { activeMetrics->dispatches++; }
+    } // Otherwise:  (if the process state was not "ready" to begin with)
+    else { cout << "Could not run process " << processID << " - [" << stateName(processState) << "]" << endl; } // Print error message
 }
 
-void PCB::admitProcess(PCB** ready) { // Used to admit processes in the new state into the ready state at the beginning of the simulation (since all processes arrive at t=0)
-    if ((processState == "new") && ready != NULL) { // First check if the PCB's process state is at new and that the pointer to ready list pointer is not null
-        processState = "ready";  // If so, set the current process state to ready (If not, then the *ready list pointer must not have been found from the **ready double pointer)
-        if (*ready == NULL) { *ready = this; }  // If the ready list pointer is null (empty list), set the head of the list to this process
-        else { (*ready)->getLast()->pcbPointer = this; } // If the ready list is not empty, then get the very last PCB in that list and then add the current PCB onto the end of its next pointer
-    }  // If the double pointer was not found or the process was not in the new state (must be in new to be 'admitted' to ready)
-    else { cout << "Could not admit process " << processID << " - [" << processState << "]" << endl; } // Print error message
+void PCB::waitProcess(PCB** running, PCB** waiting, int time) { // Moves current process from running to waiting list
+    if (processState == RUNNING) {  // Check if the current PCB's process state is running (can not go to waiting list unless currently running)
+        accountTo(time);            // Add the time spent running to the cpu time
+        processState = WAITING;    //  If so, update current PCB's process state to waiting
+        burstEnd = time + burstLeft; // The IO burst finishes this long from now
+        unlinkFrom(running);  // Now that the process is moving to the waiting list, the running list is empty
+        appendTo(waiting);   // Add the current process to the end of the waiting list
+        trace(RUNNING, time, TRACE_IO_STARTED);
+    } // Otherwise:  (if the process state was not "running" to begin with)
+    else { cout << "Could not move process " << processID << " to waiting queue - " << "[" << stateName(processState) << "]" << endl; } // Print error message
 }
 
-void PCB::runProcess(PCB** ready, PCB** running, int time) {  // moves process from ready list to running, preempting 
-    if (processState == "ready") {  // First check if process is in ready state (process can only go into running state from ready)
-        processState = "running";  // Set current process state to running
-        if (*ready == this) {     // If the head of the ready list is the current PCB
-            *ready = pcbPointer; // set the head of ready list to this PCB's next pointer (if null, then list is empty)
-        }
-        else { // Otherwise (if the current PCB is not the head of the ready list)
-            PCB* temp = *ready;  // Use temporary pointer to go through ready list to find the preceding PCB to the current one
-            if (temp->pcbPointer != NULL) {  // If the temporary PCB's pointer to next PCB (in ready list) is valid:
-                while (temp->pcbPointer != this) { temp = temp->pcbPointer; } // Go through each of the descendants of the temporary PCB pointer
-                temp->pcbPointer = temp->pcbPointer->pcbPointer; // After using while loop to find parent of running PCB, set its next PCB pointer to the current PCB's next pointer to mend the list
-            }
-        }
-        *running = this;    // Set the running pointer to the current PCB
-        pcbPointer = NULL; // Set the next PCB pointer to NULL since there is only 1 process running at a time (no 'next' pointers in running)
-        if (responseTime == -1) { responseTime = time; } // set response time when process is ran (if first time -1)
+template <class Queue>
+void PCB::readyProcess(PCB** waiting, Queue* ready, int time, TraceReason reason) {      // Moves process from waiting list (or running, when preempted or its quantum runs out) to the ready queue
+    if (processState == WAITING || processState == RUNNING) {  // Check if the current PCB's proccess state is waiting or running (can not go to ready queue unless the currently in waiting list, or preempted from running)
+        ProcessState from = processState;  // Waiting or running, for the trace
+        accountTo(time);        // Add the time spent waiting or running to the io or cpu time (and running time to the vruntime)
+        burstLeft = processState == RUNNING ? burstEnd - time : 0;  // A preempted process saves the rest of its CPU burst - a finished IO burst leaves nothing
+        processState = READY;  // If so, update the current PCB's process state to ready
+        unlinkFrom(waiting);  // Take it out of the waiting (/running) list
+        ready->push(this);   // and add it to the ready queue
+        trace(from, time, reason);
+    } // If not in the correct state(s) to begin with:
+    else { cout << "Could not move process " << processID << " to ready list - " << "[" << stateName(processState) << "]" << endl; }  // Print error message
+}
 
-    } // Otherwise:  (if the process state was not "ready" to begin with)
-    else { cout << "Could not run process " << processID << " - [" << processState << "]" << endl; } // Print error message
+void PCB::appendTo(PCB** list) {  // Adds this PCB after the tail of a list - O(1), since the head points back to the tail
+    pcbPointer = NULL;  // It will be the last PCB of the list
+    if (*list == NULL) { *list = this;  prevPointer = this; }  // Empty list: this PCB is both head and tail
+    else {
+        PCB* tail = (*list)->prevPointer;  // Current last PCB
+        tail->pcbPointer = this;          // Link this PCB after it
+        prevPointer = tail;
+        (*list)->prevPointer = this;    // The head points back to the new tail
+    }
 }
 
-void PCB::waitProcess(PCB** running, PCB** waiting) { // Moves current process from running to waiting list
-    if (processState == "running") {  // Check if the current PCB's process state is running (can not go to waiting list unless currently running)
-        processState = "waiting";    //  If so, update current PCB's process state to waiting
-        if (*waiting == NULL) { *waiting = this; }  // If the waiting list head pointer is NULL (list is empty), set the pointer to head of list to the current process
-        else { (*waiting)->getLast()->pcbPointer = this; } // If the waiting list is not empty, get the last PCB of the list and set its next pointer to the current process
-        *running = NULL;    // Now that the process has been moved to the waiting list, set the running list to NULL (empty)
-        pcbPointer = NULL; // Make sure that the pointer to next PCB is set to NULL since the current process is at the very end of the waiting list
-    } // Otherwise:  (if the process state was not "running" to begin with)
-    else { cout << "Could not move process " << processID << " to waiting queue - " << "[" << processState << "]" << endl; } // Print error message
-}
-
-void PCB::readyProcess(PCB** waiting, PCB** ready) {                // Moves process from waiting list to ready queue
-    if (processState == "waiting" || processState == "running") {  // Check if the current PCB's proccess state is waiting or ready (can not go to ready queue unless the currently in waiting list, or preempted from running)
-        processState = "ready";  // If so, update the current PCB's process state to ready
-        if (*waiting == this) { *waiting = pcbPointer; }    // If the head of the waiting(/running) list is the current process: set the new head of the waiting list to the pointer to next PCB (if NULL, empty list)
-        else {  // If the current process is not the head of the waiting list:
-            PCB* temp = *waiting;             // Set a temporary pointer to PCB as the head of the waiting list
-            if (temp->pcbPointer != NULL) {  // Check if pointer is valid
-                while (temp->pcbPointer != this) { temp = temp->pcbPointer; }  // Loop through list to find which PCB holds its next pcb pointer to the current process
-                temp->pcbPointer = temp->pcbPointer->pcbPointer;  // Increment the temporary pointer to the next pcb
-            }
-        } // Set the ready list:
-        if (*ready == NULL) { *ready = this; } // If the list is empty, initialize it with this PCB
-        else { (*ready)->getLast()->pcbPointer = this; }  // Otherise (if it is not empty) add this PCB to the last list item's next pcbPointer
-        pcbPointer = NULL;  // Since it is at the end of the list, make sure the next pcb pointer is null
-    } // If not in the correct state(s) to begin with:
-    else { cout << "Could not move process " << processID << " to ready list - " << "[" << processState << "]" << endl; }  // Print error message
+void PCB::unlinkFrom(PCB** list) {  // Takes this PCB out of a list, mending the list around it - O(1) using the previous pointer
+    if (*list == this) {  // If this PCB is the head, the next PCB becomes the new head (if NULL, empty list)
+        *list = pcbPointer;
+        if (pcbPointer != NULL) { pcbPointer->prevPointer = prevPointer; }  // The new head points back to the tail
+    }
+    else {  // Otherwise skip over this PCB
+        prevPointer->pcbPointer = pcbPointer;
+        if (pcbPointer != NULL) { pcbPointer->prevPointer = prevPointer; }
+        else { (*list)->prevPointer = prevPointer; }  // If this PCB was the tail, the one before it is the new tail
+    }
+    pcbPointer = NULL;  prevPointer = NULL;  // No longer in a list
 }
 
 void PCB::terminateProcess(PCB** running, PCB** terminated, int time) {
-    if (processState == "running") {  // Check if running  (can not terminate from other states)
-        if (*terminated == NULL) { *terminated = this; }        // If the terminated list is empty, initialize it with pointer to this PCB
-        else { (*terminated)->getLast()->pcbPointer = this; }  // Otherwise (if list is not empty) get the last PCB item of the terminated list and add the current PCB to it's next pointer
-        *running = NULL;  // Since the running task has been terminated, set the running pointer to null (empty)
-        processState = "terminated";  // Update the process state to terminated
-        terminationTime = time;      // Use the time input to the function in order to record the time of termination in var
-        pcbPointer = NULL; // Since now at the end of terminated list, make sure next pointer is null
+    if (processState == RUNNING) {  // Check if running  (can not terminate from other states)
+        accountTo(time);  // Add the time spent running to the cpu time
+        burstLeft = 0;   // Last burst is finished
+        unlinkFrom(running);    // Since the running task has been terminated, the running list is empty
+        appendTo(terminated);  // Add the current PCB to the end of the terminated list
+        processState = TERMINATED;  // Update the process state to terminated
+        trace(RUNNING, time, TRACE_FINISHED);
+        if (activeMetrics != NULL) {  // Count its times now, rather than going through every process at the end
+            activeMetrics->waiting.add(waitingTime);
+            activeMetrics->turnaround.add(time - arrivalTime);
+            activeMetrics->response.add(responseTime);
+        }
     }                     // Otherwise:  (if state was not running to begin with)
-    else { cout << "Could not terminate process " << processID << " - [" << processState << "]" << endl; } // Print error message
+    else { cout << "Could not terminate process " << processID << " - [" << stateName(processState) << "]" << endl; } // Print error message
 }
 
-void PCB::incrementPC() {              // Increments the dataIndex, or program counter index in the array of process data (IO/CPU bursts)
-    if (dataIndex + 1 <= dataSize) {  // If the data index is less than the total size of the data array
-        dataIndex++;                 // Increment the data index to the next index in the data array
-        dataTime += processData[dataIndex];  // Add to the process dataTime with the new processData index so that the total burst time can be saved
-    }
+bool PCB::moveToCPU(int icpu, int cost) {  // Called just before the process runs - a process that moves CPU has to warm up the new CPU's caches first
+    bool migrated = cpu >= 0 && cpu != icpu;  // Only a process that ran somewhere else migrates
+    if (migrated) { burstLeft += cost; }   // The warm up makes the burst take longer
+    cpu = icpu;
+    return migrated;
+}
+
+void PCB::accountTo(int time) {  // Adds the time since the process entered its current state onto the timer for that state - called on every state change instead of every time unit
+    if (processState == READY) { waitingTime += time - stateSince; }       // Time in the ready queue is waiting time
+    else if (processState == RUNNING) { vruntime += (long long)(time - stateSince) * VRUNTIME_SCALE / weight; }   // Time in the CPU adds to the vruntime in inverse proportion to the weight (CPU and IO time need no timers - with the waiting time they add up to the turnaround)
+    stateSince = time;  // The next state starts now
+}
+
+long long PCB::getVruntime(int time) {  // The vruntime is only added to when the process stops running, so a running process adds the time since it started
+    if (processState == RUNNING) { return vruntime + (long long)(time - stateSince) * VRUNTIME_SCALE / weight; }
+    return vruntime;
+}
+
+void PCB::traceRecord(ProcessState from, int time, TraceReason reason) {  // Called by trace() after a state change, so processState is the new state
+    TraceRecord r;
+    r.time = time;  r.pid = processID;
+    r.burst = processState == READY ? nextBurst() : (processState == RUNNING || processState == WAITING) ? burstEnd - time : 0;
+    r.cpu = (int16_t)(cpu < 0 ? 0 : cpu);
+    r.from = from;  r.to = processState;  r.reason = reason;  r.priority = priority;
+    r.pad[0] = r.pad[1] = 0;
+    activeTrace->record(r);
+}
+
+void PCB::save(PCBRecord* r) {  // The place and queue are filled in by the engine, which knows where the process is
+    r->vruntime = vruntime;
+    r->processID = processID;  r->dataSize = dataSize;  r->dataIndex = dataIndex;  r->burstLeft = burstLeft;  r->burstEnd = burstEnd;  r->stateSince = stateSince;
+    r->waitingTime = waitingTime;  r->arrivalTime = arrivalTime;  r->responseTime = responseTime;
+    r->timeQuantum = timeQuantum;  r->quantumEnd = quantumEnd;  r->cpu = cpu;  r->weight = weight;
+    r->state = (uint8_t)processState;  r->priority = priority;
+    memset(r->pad, 0, sizeof(r->pad));
+}
+
+void PCB::restore(const PCBRecord& r, const int* bursts, PCB** list) {  // A ready process is not added to a list - the engine pushes it into its ready queue (and a generated process is given its bursts with generateBursts() after)
+    newProcess();
+    vruntime = r.vruntime;
+    processID = r.processID;  dataSize = r.dataSize;  dataIndex = r.dataIndex;  burstLeft = r.burstLeft;  burstEnd = r.burstEnd;  stateSince = r.stateSince;
+    waitingTime = r.waitingTime;  arrivalTime = r.arrivalTime;  responseTime = r.responseTime;
+    timeQuantum = r.timeQuantum;  quantumEnd = r.quantumEnd;  cpu = r.cpu;  weight = r.weight;
+    processState = (ProcessState)r.state;  priority = r.priority;
+    processData = bursts;
+    if (list != NULL) { appendTo(list); }
 }
 
-void PCB::cpuManage(PCB** running, PCB** waiting, PCB** terminated, int time) { // Used by SJF and FCFS schedulers to manage the CPU (called on running pointer if not null)
-    if (dataTime - ioTime - cpuTime == 0) { // If the ioTime and cpuTime that the process has taken is subtracted from the total burst time at this stage, and gets, 0, then the current burst must be finished
+void PCB::cpuManage(PCB** running, PCB** waiting, PCB** terminated, int time, EventQueue* events) { // Used by SJF and FCFS schedulers to manage the CPU (called on running pointer if not null)
+    if (time >= burstEnd) { // If the time the CPU burst finishes at has been reached, then the current burst must be finished
         if (dataIndex + 1 >= dataSize) { terminateProcess(running, terminated, time); }  // If at the last stage of the CPU/IO bursts, then terminate process
-        else { incrementPC();  waitProcess(running, waiting); } // Otherwise (if not at the last burst) increment the index and total burst time from the burst array and send the process to waiting list
+        else { incrementPC();  waitProcess(running, waiting, time);  events->schedule(burstEnd, IO_COMPLETE, this); } // Otherwise (if not at the last burst) move on to the IO burst, send the process to waiting list and schedule the end of its IO burst
     }
 }
 
-void PCB::waitManage(PCB** waiting, PCB** ready) { // Used by all schedulers to check if finished with IO burst and can be moved to ready queue (called recursively from the waiting list pointer)
-    if (dataTime - ioTime - cpuTime == 0) {       // If finished with the current burst ( total burst time - io/cpu time taken so far: if 0, the burst is at its end )
-        PCB* p = pcbPointer;  // Use temporary pointer to the next PCB in the waiting list
-        readyProcess(waiting, ready);  // Ready the current process
-        if (p != NULL) { p->waitManage(waiting, ready); } // Call recursively on the next PCBs in the waiting list
+template <class Queue>
+bool PCB::waitManage(PCB** waiting, Queue* ready, int time) { // Used by all schedulers to check if finished with IO burst and can be moved to ready queue (called when the I/O completion event of this process fires)
+    if (processState == WAITING && time >= burstEnd) { // If waiting and the time the IO burst finishes at has been reached
+        readyProcess(waiting, ready, time, TRACE_IO_DONE);  // Ready the current process
+        return true;
     }
-    else { // Otherwise: (if current burst has not finished)
-        if (pcbPointer != NULL) { pcbPointer->waitManage(waiting, ready); }  // If the next pointer is not null, call recursively on it to check the bursts of the other processes
+    return false;
+}
+
+void PCB::printStatus(int time) {  // Called at each context switch to go through each process in a list (called on head of list)
+    for (PCB* p = this; p != NULL; p = p->pcbPointer) {  // Loop rather than recursing, so long lists can't overflow the stack
+        p->printOne(time);  // Print this process
+        if (p->pcbPointer != NULL && p->processState != p->pcbPointer->processState) {  // Check if the next pointer's state different from the current state - if so, print error message
+            cout << "Error - (" << p->processID << ") " << stateName(p->processState) << " != (" << p->pcbPointer->processID << ") " << stateName(p->pcbPointer->processState) << "!" << endl;
+            return;
+        }
     }
 }
 
-void PCB::printStatus() {           // Called at each context switch to recursively go through each process in a list (called on head of list)
-    if (processState == "ready") { // If the current process is in ready state
-        cout << "P" << processID << " [Next CPU burst: " << processData[dataIndex+1] << "]" << endl; // Print the process ID (P1, P2,.. P8) and burst time
+void PCB::printOne(int time) {  // Prints the status line of this process alone
+    if (processState == READY) { // If the current process is in ready state
+        cout << "P" << processID << " [Next CPU burst: " << nextBurst() << "]" << "\n"; // Print the process ID (P1, P2,.. P8) and burst time
     }
-    else if (processState == "running") {     // If the current process is in running state
-        cout << "Running: P" << processID << endl; // Print the process ID (P1, P2,.. P8)
+    else if (processState == RUNNING) {     // If the current process is in running state
+        cout << "Running: P" << processID << "\n"; // Print the process ID (P1, P2,.. P8)
     }
-    else if (processState == "waiting") {     // If the current process is in waiting state
-        cout << "P" << processID << " [Remaining IO burst: " << dataTime - (ioTime + cpuTime) << "]" << endl;  // Print the process ID (P1, P2,.. P8) and its remaining burst time
+    else if (processState == WAITING) {     // If the current process is in waiting state
+        cout << "P" << processID << " [Remaining IO burst: " << burstEnd - time << "]" << "\n";  // Print the process ID (P1, P2,.. P8) and its remaining burst time
     }
-    else if (processState == "terminated") {  // If the current process is in terminated state
-        cout << "P" << processID << " Terminated at time: " << terminationTime << endl;  // Print the process ID (P1, P2,.. P8) and its time of termination from var
+    else if (processState == TERMINATED) {  // If the current process is in terminated state
+        cout << "P" << processID << " Terminated at time: " << stateSince << "\n";  // Print the process ID (P1, P2,.. P8) and its time of termination
     }
-    if (pcbPointer != NULL) {  // If the next PCB pointer is valid: 
-        if (processState != pcbPointer->processState) { cout << "Error - (" << processID << ") " << processState << " != (" << pcbPointer->processID << ") " << processState << "!" << endl; }
-        else {// Check if the next pointer's state different from the current state - if so, print error message
-            pcbPointer->printStatus(); // If correct, call recursively on next PCB pointer
-        }
+}
+
+void PCB::printTable(const SimulationResult& result) { // Called at the end of each simulation on the terminated list - O(n), each process is placed by its ID instead of searching the list for the next ID
+    vector<PCB*> byID;  // Terminated processes, indexed by process ID
+    for (PCB* p = this; p != NULL; p = p->pcbPointer) {
+        if (p->processID >= (int)byID.size()) { byID.resize(p->processID + 1, NULL); }
+        byID[p->processID] = p;
+    }
+    for (size_t id = 0; id < byID.size(); id++) {  // Print the results in order of instruction sample format
+        PCB* p = byID[id];
+        if (p != NULL) { cout << "P" << p->processID << "    Tw = " << p->waitingTime << "    Ttr = " << (p->stateSince - p->arrivalTime) << "    Tr = " << p->responseTime << "\n"; }
     }
+    printMetrics(result);
 }
 
-void PCB::printTable(PCB* head, int id) { // Called at the end of each simulation, prints all details of processes in list (terminated), in numeric order
-    if (id < head->getLength()) {  // Check if the process number is still less than list length:
-        PCB* search = head;  // Use temporary PCB pointer search starting at the head of the list to go through and find the next process
-        while (search != NULL && search->processID != id + 1) { search = search->pcbPointer; } // Use loop to go through list and find the next numeric process ID
-        if (search != NULL) { // If not found, the search pointer will be null - however if found:
-            if (id + 1 == 1) { search->ioTime--; } else { search->waitingTime--; }  // Adjust timing for accurate result
-            cout << "P" << search->processID << "    Tw = " << (search->waitingTime) << "    Ttr = " << (search->waitingTime  + search->ioTime + search->cpuTime) << "    Tr = " << search->responseTime << endl;
-        }  // Print the results in order of instruction sample format ^
-        search->printTable(head, id + 1);  // Call recursively on next item in list
+void printMetrics(const SimulationResult& result) { // Prints the averages, percentiles and throughput of a simulation
+    const Metrics& m = result.metrics;
+    cout << "Avg" << "   Tw = " << m.waiting.mean() << "    Ttr = " << m.turnaround.mean() << "    Tr = " << m.response.mean() << "\n"; // Print the averages
+    const Histogram* times[] = { &m.waiting, &m.turnaround, &m.response };
+    const char* names[] = { "Tw ", "Ttr", "Tr " };
+    for (int i = 0; i < 3; i++) {  // Then the tail of each time
+        cout << names[i] << "   p50 = " << times[i]->percentile(50) << "    p90 = " << times[i]->percentile(90) << "    p99 = " << times[i]->percentile(99) << "    p99.9 = " << times[i]->percentile(99.9) << "    max = " << times[i]->max() << "\n";
     }
-    else if (id == head->getLength()) { // Check if finished printing list of process details
-        float avgTw = 0;      // Initialize average waiting time variable for calculation
-        float avgTtr = 0;    // Initialize average turnaround time variable for calculation
-        float avgTr = 0;    // Initialize average response time variable for calculation
-        PCB* i = head;     // Use temporary pointer i initialized at the head of the list to loop through
-        int avgcount = 0; // Initialize variable to hold the count of # of averaged values
-        while (i != NULL) {  // Use loop to go through list and accumulate average var if i is valid
-            avgTw += i->waitingTime;  // Accumulate avg waiting time
-            avgTtr += i->waitingTime + i->ioTime + i->cpuTime; // Accumulate avg turnaround time (waiting time + io time + cpu time)
-            avgTr += i->responseTime; // Accumulate avg response time
-            i = i->pcbPointer;  // Set i to the next PCB pointer to average next PCB values
-            avgcount++;  // Increment the number of averaged values for each var
-        }
-        avgTw = avgTw / avgcount;  // average = accumulated values / total num of values
-        avgTtr = avgTtr / avgcount; // average = accumulated values / total num of values
-        avgTr = avgTr / avgcount; // average = accumulated values / total num of values
-        cout << "Avg" << "   Tw = " << avgTw << "    Ttr = " << avgTtr << "    Tr = " << avgTr << endl; // Print the averages
+    cout << "Throughput: " << (result.totalTime > 0 ? (double)m.turnaround.count() / result.totalTime : 0.0) << " processes per time unit" << endl;
+}
+
+// called to manage CPU
+void PCB::cpuManageMLFQ(MLFQQueues* ready, PCB** running, PCB** waiting, PCB** terminated, int time, EventQueue* events, const MLFQConfig& config) {  // Called by the MLFQ policy at every event on the running process (preemption by a higher level is checked after)
+    int quantum = config.quanta[priority - 1];  // Time quantum of this process's level (0 if the level runs to completion)
+    if (time >= burstEnd) { // If the burst is finished:  (if the time the CPU burst finishes at has been reached)
+        if (quantum > 0) { timeQuantum = quantum; }  // Reset the time quantum based on priority
+        if (dataIndex + 1 >= dataSize) { terminateProcess(running, terminated, time); }  // If finished the last burst, terminate the process
+        else { incrementPC();  waitProcess(running, waiting, time);  events->schedule(burstEnd, IO_COMPLETE, this); }  // If not on the last burst, send to waiting queue and schedule the end of its IO burst
+    }
+    else if (quantum > 0 && time >= quantumEnd) { // If the time quantum is finished before the burst:
+        if (priority < config.levels) { priority++;  COUNT(demotions++); }  // Go down one level, unless already at the lowest
+        timeQuantum = config.quanta[priority - 1];    // and take the time quantum of that level
+        readyProcess(running, ready, time, TRACE_QUANTUM_EXPIRED);  // Send process to ready queue
+    }
+}
+
+
+
+void ReadyHeap::push(PCB* pcb) {  // Inserts a process at the bottom of the heap and moves it up into place - O(log n)
+    entries.push_back(Entry{ byPriority ? pcb->getPriority() : pcb->nextBurst(), pushed++, pcb });  // Add it to the end of the heap array, keyed on its next CPU burst (or priority)
+    pcb->setHeapIndex(size() - 1);  // Save its slot in the PCB
+    siftUp(size() - 1);  // Move it up past any parents with longer bursts
+}
+
+void ReadyHeap::remove(PCB* pcb) {  // Takes a process out of the heap - O(log n)
+    int i = pcb->getHeapIndex();   // Slot the process is in
+    if (i < 0 || i >= size() || entries[i].pcb != pcb) { return; }  // Not in this heap
+    swapEntries(i, size() - 1);  // Swap it with the last slot
+    entries.pop_back();         // and drop it off the end
+    pcb->setHeapIndex(-1);     // It is no longer in the heap
+    if (i < size()) { siftUp(i); siftDown(i); }  // The entry moved into its slot may need to go either way
+}
+
+void ReadyHeap::decreaseKey(PCB* pcb, int key) {  // Lowers the key of a process in the heap - O(log n)
+    int i = pcb->getHeapIndex();  // Slot the process is in
+    if (i < 0 || i >= size() || entries[i].pcb != pcb || key > entries[i].key) { return; }  // Not in this heap, or the key would go up
+    entries[i].key = key;  // Save the new key
+    siftUp(i);  // A smaller key can only move up
+}
+
+vector<Event> EventQueue::pending() {  // Pops a copy of the queue, so the events come out in order
+    priority_queue<Event, vector<Event>, greater<Event>> copy = events;
+    vector<Event> all;
+    while (!copy.empty()) { all.push_back(copy.top());  copy.pop(); }
+    return all;
+}
+
+void ReadyHeap::collect(vector<PCB*>* out) {  // Sorts a copy of the slots by push order - aging lowers keys, so equal keys later on must still be served in the order the processes were pushed
+    vector<Entry> sorted = entries;
+    sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return a.seq < b.seq; });
+    for (size_t i = 0; i < sorted.size(); i++) { out->push_back(sorted[i].pcb); }
+}
+
+void ReadyHeap::printStatus(int time) {  // Prints every ready process in the order they were pushed, as the ready list was printed before the heap (and as --render prints it)
+    vector<PCB*> ordered;
+    collect(&ordered);
+    for (size_t i = 0; i < ordered.size(); i++) { ordered[i]->printStatus(time); }  // Heap PCBs are not linked, so each call only prints one PCB
+}
+
+void ReadyHeap::swapEntries(int a, int b) {  // Swaps two slots, keeping the slot saved in each PCB up to date
+    Entry e = entries[a]; entries[a] = entries[b]; entries[b] = e;  // Swap the slots
+    entries[a].pcb->setHeapIndex(a);  // Update the saved slot of each PCB
+    entries[b].pcb->setHeapIndex(b);
+}
+
+void ReadyHeap::siftUp(int i) {  // Moves an entry up while it comes before its parent
+    while (i > 0 && before(i, (i - 1) / 2)) { swapEntries(i, (i - 1) / 2); i = (i - 1) / 2; }  // Parent of slot i is (i-1)/2
+}
+
+void ReadyHeap::siftDown(int i) {  // Moves an entry down while one of its children comes before it
+    while (true) {
+        int smallest = i;  // Find which of i and its two children should come first
+        if (2 * i + 1 < size() && before(2 * i + 1, smallest)) { smallest = 2 * i + 1; }
+        if (2 * i + 2 < size() && before(2 * i + 2, smallest)) { smallest = 2 * i + 2; }
+        if (smallest == i) { return; }  // In place
+        swapEntries(i, smallest);  // Otherwise swap with the child and keep going
+        i = smallest;
     }
 }
 
-int PCB::getLength() {  // Used to get length of the current list (called on the head of list)
-    PCB* p = this;  // Use temporary pointer p for loop
-    int count = 1; // Initialize count variable at 1 since the current PCB counts as 1 length
-    while (p != NULL) { p = p->pcbPointer; count++; } // If temporary pointer p is not null, go to the next pointer and increment the count
-    return count;  // When pointer p is finally null, return the number of iterations (length)
+
+
+VruntimeTree::VruntimeTree(long long icredit) {
+    nodes.push_back(Node{ 0, 0, NULL, 0, 0, 0, false });  // The nil node - black, so the leaves of every path count the same
+    root = 0;  leftmost = 0;  freeNodes = 0;  count = 0;
+    pushed = 0;  minKey = 0;  credit = icredit;  weights = 0;  woken = INT64_MAX;
 }
 
-PCB* PCB::getFirstPriority(int ipriority) { // Called on the head of the ready list to find first PCB with the input priority, ipriority
-    if (priority == ipriority) { // If the priority matches:
-        return this;  // Return pointer to the current PCB
+void VruntimeTree::push(PCB* pcb) {  // Inserts a process - O(log n)
+    if (pcb->getVruntime(0) < minKey - credit) { pcb->setVruntime(minKey - credit); }  // A process that slept a long time only keeps credit worth of catching up, so it can't hold the CPU until it draws level
+    int z = freeNodes;  // Reuse a free node if there is one
+    if (z != 0) { freeNodes = nodes[z].right; }
+    else { z = (int)nodes.size();  nodes.push_back(Node()); }
+    nodes[z] = Node{ pcb->getVruntime(0), pushed++, pcb, 0, 0, 0, true };  // New nodes are red
+    int parent = 0;  bool leftmostPath = true;  // Stays true if the new node only goes left, so it is the new leftmost
+    for (int x = root; x != 0; ) {  // Walk down to the leaf it belongs at
+        parent = x;
+        if (before(z, x)) { x = nodes[x].left; } else { x = nodes[x].right;  leftmostPath = false; }
     }
-    else {  // Otherwise:  (if it doesn't match)
-        if (pcbPointer == NULL) { return NULL; }  // If at the end of the list, return null since the priority was not found in any process
-        else { return pcbPointer->getFirstPriority(ipriority); }  // Otherwise (priority not found, and not at end of the list) call recursively on next PCB pointer!
+    nodes[z].parent = parent;
+    if (parent == 0) { root = z; }
+    else if (before(z, parent)) { nodes[parent].left = z; }
+    else { nodes[parent].right = z; }
+    if (leftmostPath) { leftmost = z; }
+    pcb->setHeapIndex(z);  // Save its node in the PCB
+    count++;  weights += pcb->getWeight();
+    insertFixup(z);
+}
+
+void VruntimeTree::remove(PCB* pcb) {  // Takes a process out of the tree - O(log n)
+    int z = pcb->getHeapIndex();  // Node the process is in
+    if (z <= 0 || z >= (int)nodes.size() || nodes[z].pcb != pcb) { return; }  // Not in this tree
+    if (z == leftmost) { leftmost = nodes[z].right != 0 ? minimum(nodes[z].right) : nodes[z].parent; }  // The leftmost has no left child, so the next node is the least of its right subtree, or else its parent
+    int y = z;  bool removedRed = nodes[y].red;  // Node taken out of its place in the tree, and its colour
+    int x;  // Node that moves into y's place
+    if (nodes[z].left == 0) { x = nodes[z].right;  transplant(z, x); }
+    else if (nodes[z].right == 0) { x = nodes[z].left;  transplant(z, x); }
+    else {  // Two children: the next node y takes z's place
+        y = minimum(nodes[z].right);
+        removedRed = nodes[y].red;
+        x = nodes[y].right;
+        if (nodes[y].parent == z) { nodes[x].parent = y; }
+        else { transplant(y, x);  nodes[y].right = nodes[z].right;  nodes[nodes[y].right].parent = y; }
+        transplant(z, y);
+        nodes[y].left = nodes[z].left;  nodes[nodes[y].left].parent = y;
+        nodes[y].red = nodes[z].red;
     }
+    if (!removedRed) { deleteFixup(x); }
+    nodes[z].pcb = NULL;  nodes[z].right = freeNodes;  freeNodes = z;  // Free the node
+    pcb->setHeapIndex(-1);  // It is no longer in the tree
+    count--;  weights -= pcb->getWeight();
 }
 
-// called to manage CPU
-void PCB::cpuManageMLFQ(PCB** ready, PCB** running, PCB** waiting, PCB** terminated, int time) {  // Called in MLFQ scheduler to check 
-    if (dataTime - ioTime - cpuTime == 0) { // If the burst is finished:  (if the total burst time - total io/cpu time = 0)
-        if (priority == 1) {timeQuantum=5; } else if (priority == 2) { timeQuantum=10; }  // Reset the time quantum based on priority
-        if (dataIndex + 1 >= dataSize) { terminateProcess(running, terminated, time); }  // If finished the last burst, terminate the process
-        else { incrementPC();  waitProcess(running, waiting); }  // If not on the last burst, send to waiting queue
-    }
-    else if ((priority==1 || priority==2) && timeQuantum == 0) { // If the time quantum is finished before the burst:
-        if (priority == 1) { priority++; timeQuantum=10; } else if (priority == 2) { priority++; } // If priority is 1 or 2, increment, if the priority was 1 then the tq goes to priority 2 tq (tq=10)
-        readyProcess(running, ready);  // Send process to ready queue
-    }
-    else if (*ready != NULL) { // If ready list exists (preemption)
-        if ((priority == 2 || priority == 3) && (*ready)->getFirstPriority(1) != NULL) { // If the priority of current process is 2 or 3 and there is a priority 1 process in ready queue ready to preempt:
-            if (priority == 2) { timeQuantum = 10; } // If the priority of this process (preempted) is 2, then reset its tq at 10 for next run
-            readyProcess(running, ready);  // Send the current process to the ready queue since it is preempted - on next section of scheduler the highest priority process will run
-            cout << "\nPREEMPTION: time:" << time << " Currently running: P" << processID << " p" << priority << "  Preemption from: P" << (*ready)->getFirstPriority(1)->processID << " p" << (*ready)->getFirstPriority(1)->priority << endl;
-        } // Print message
-        else if (priority == 3 && (*ready)->getFirstPriority(2) != NULL) { // If the priority of the current process is 3 and there is a priority 2 process in the ready queue ready to preempt:
-            readyProcess(running, ready); // Send the current process to the ready queue since it is preempted - on next section of scheduler the highest priority process will run
-            cout << "\nPREEMPTION: time:" << time << " Currently running: P" << processID << " p" << priority << "  Preemption from: P" << (*ready)->getFirstPriority(2)->processID << " p" << (*ready)->getFirstPriority(2)->priority << endl;
-        } // Print message
-    }
-}
-
-
-
-// Non-member functions: //
-
-void programCounter(PCB* ready, PCB* running, PCB* waiting) { // Called in schedulers to call on class functions to increment timings
-    if (ready != NULL) { ready->waitTiming(); }      // If ready queue has PCBs, call recursive function wait Timing to increment all of the waiting times
-    if (running != NULL) { running->cpuTiming(); }  // If cpu has a PCB, call recursive function wait Timing to increment cpu Time
-    if (waiting != NULL) { waiting->ioTiming(); }  // If waiting list has PCBs, call recursive function wait Timing to increment all of the io times
-}
-
-void scheduleSJF(PCB** ready, PCB** running, PCB** waiting, PCB** terminated) {  // SCHEDULER - Shortest Job First scheduling simulation
-    if (ready != NULL && running != NULL && waiting != NULL && terminated != NULL) { // If the double pointers to the pre-initialized lists are valid, proceed:
-        int idleTime = 0;  // initialize integer idleTime to keep track of how long the cpu is idle (no running processes, or *running = null)
-        for (int t = 0; t <= 1024; t++) {  // TIME loop - time units t
-            if (*waiting != NULL) {  // If there is at least one process in the waiting list:   (or not null)
-                (*waiting)->waitManage(waiting, ready); // call wait manage to manage the waiting list
-            }  // next:
-            if (*running != NULL) {  // If there is a process running:
-                (*running)->cpuManage(running, waiting, terminated, t); // Call cpuManage to determine what to do with the running process
-            }  // next:
-            if (*running == NULL) {     // Check if no processes are running (no preemption)
-                if (*ready != NULL) {  // If there is a process in ready queue:
-                    (*ready)->getShortest()->runProcess(ready, running, t);  // Run shortest process in ready queue
-                    (*running)->incrementPC(); // Increment the progam counter upon run
-                    cout << "\n[SJF] Current Execution time: " << t << endl; // Print scheduler type, and the current exec time
-                    (*running)->printStatus(); // Print the status of the process currently running
-                    if (*ready != NULL) { cout << "Ready:" << endl; (*ready)->printStatus(); } // If something in ready list, call recursive print status on list head to print the whole list
-                    if (*waiting != NULL) { cout << "Waiting:" << endl; (*waiting)->printStatus(); } // If something in waiting list, call recursive print status on list head to print the whole list
-                    if (*terminated != NULL) { cout << "Terminated:" << endl; (*terminated)->printStatus(); } // If something in terminated list, call recursive print status on list head to print the whole list
-                }
-            }
-            if (*ready == NULL && *waiting == NULL && *running == NULL) { // If all queues are finished then print final table and end loop
-                if (*terminated != NULL) { // If the terminated list is valid and not empty:   (All processes should end up in terminated list)
-                    cout << "\nSJF Results:\nTotal time: " << t-1 << "  CPU Utilization: " << (1 - (float)idleTime / (t-1)) * 100 << "%" << endl; // Print the scheduler type, total time taken, and CPU utilization
-                    (*terminated)->printTable(*terminated, 0); // Then print all of the processes in table (in terminated list)
-                } // finished
-                return;
-            }
-            else { // Otherwise:   (if the lists are not empty)
-                if (*running == NULL) { idleTime++; } // If there is nothing running, increment the idleTime var
-                programCounter(*ready, *running, *waiting); // Increment the waiting, cpu, and io times
-            }
+void VruntimeTree::advance(long long v) {  // Like the kernel's min_vruntime - follows the lowest of the running and leftmost vruntimes, but never goes back
+    if (count > 0 && firstKey() < v) { v = firstKey(); }
+    if (v > minKey) { minKey = v; }
+}
+
+void VruntimeTree::wake(PCB* pcb) {  // Slice ends and preemptions requeue without a wakeup
+    if (pcb->getVruntime(0) < woken) { woken = pcb->getVruntime(0); }  // Its key - push has already moved it up to the minimum less the credit
+}
+
+long long VruntimeTree::takeWoken() {
+    long long v = woken;
+    woken = INT64_MAX;
+    return v;
+}
+
+void VruntimeTree::printStatus(int time) {  // Prints every ready process in order
+    vector<PCB*> ordered;
+    collect(&ordered);
+    for (size_t i = 0; i < ordered.size(); i++) { ordered[i]->printOne(time); }
+}
+
+void VruntimeTree::collect(vector<PCB*>* out) {  // O(n) walking from each node to the next
+    for (int x = leftmost; x != 0; ) {
+        out->push_back(nodes[x].pcb);
+        if (nodes[x].right != 0) { x = minimum(nodes[x].right); }  // Next is the least of the right subtree
+        else {  // or else the first ancestor that x is left of
+            int parent = nodes[x].parent;
+            while (parent != 0 && x == nodes[parent].right) { x = parent;  parent = nodes[x].parent; }
+            x = parent;
         }
     }
 }
 
-void scheduleFCFS(PCB** ready, PCB** running, PCB** waiting, PCB** terminated) { // SCHEDULER - First Come First Serve scheduling simulation
-    if (ready != NULL && running != NULL && waiting != NULL && terminated != NULL) {  // If the double pointers to the pre-initialized lists are valid, proceed:
-        int idleTime = 0;  // initialize integer idleTime to keep track of how long the cpu is idle (no running processes, or *running = null)
-        for (int t = 0; t <= 1024; t++) {  // TIME loop - time units t
-            if (*waiting != NULL) { // If there is at least one process in the waiting list:   (or not null)
-                (*waiting)->waitManage(waiting, ready); // call wait manage to manage the waiting list
-            } // next:
-            if (*running != NULL) {  // If there is a process running:
-                (*running)->cpuManage(running, waiting, terminated, t);  // Call cpuManage to determine what to do with the running process
-            } // next:
-            if (*running == NULL) {     // Check if no processes are running (no preemption)
-                if (*ready != NULL) {  // If there is a process in ready queue:
-                    (*ready)->incrementPC(); // Increment the progam counter upon run
-                    (*ready)->runProcess(ready, running, t);  // Run first process in ready queue
-                    cout << "\n[FCFS] Current Execution time: " << t << endl; // Print scheduler type, and the current exec time
-                    (*running)->printStatus(); // Print the status of the process currently running
-                    if (*ready != NULL) { cout << "Ready:" << endl; (*ready)->printStatus(); } // If something in ready list, call recursive print status on list head to print the whole list
-                    if (*waiting != NULL) { cout << "Waiting:" << endl; (*waiting)->printStatus(); } // If something in waiting list, call recursive print status on list head to print the whole list
-                    if (*terminated != NULL) { cout << "Terminated:" << endl; (*terminated)->printStatus(); } // If something in terminated list, call recursive print status on list head to print the whole list
-                }
-            }
-            if (*ready == NULL && *waiting == NULL && *running == NULL) { // If all queues are finished then print final table and end loop
-                if (*terminated != NULL) { // If the terminated list is valid and not empty:   (All processes should end up in terminated list)
-                    cout << "\nFCFS Results:\nTotal time: " << t - 1 << "  CPU Utilization: " << (1 - (float)idleTime / (t - 1)) * 100 << "%" << endl; // Print the scheduler type, total time taken, and CPU utilization
-                    (*terminated)->printTable(*terminated, 0); // Then print all of the processes in table (in terminated list)
-                } // Finished 
-                return;
-            }
-            else { // Otherwise:   (if the lists are not empty)
-                if (*running == NULL) { idleTime++; } // If there is nothing running, increment the idleTime var
-                programCounter(*ready, *running, *waiting); // Increment the waiting, cpu, and io times
+void VruntimeTree::rotateLeft(int x) {
+    int y = nodes[x].right;
+    nodes[x].right = nodes[y].left;
+    if (nodes[y].left != 0) { nodes[nodes[y].left].parent = x; }
+    transplant(x, y);
+    nodes[y].left = x;  nodes[x].parent = y;
+}
+
+void VruntimeTree::rotateRight(int x) {
+    int y = nodes[x].left;
+    nodes[x].left = nodes[y].right;
+    if (nodes[y].right != 0) { nodes[nodes[y].right].parent = x; }
+    transplant(x, y);
+    nodes[y].right = x;  nodes[x].parent = y;
+}
+
+void VruntimeTree::transplant(int u, int v) {  // v may be the nil node - its parent is set anyway, for deleteFixup
+    int parent = nodes[u].parent;
+    if (parent == 0) { root = v; }
+    else if (u == nodes[parent].left) { nodes[parent].left = v; }
+    else { nodes[parent].right = v; }
+    nodes[v].parent = parent;
+}
+
+void VruntimeTree::insertFixup(int z) {
+    while (nodes[nodes[z].parent].red) {  // A red node with a red parent (the root is black, so the parent has a parent)
+        int parent = nodes[z].parent, grandparent = nodes[parent].parent;
+        bool leftSide = parent == nodes[grandparent].left;
+        int uncle = leftSide ? nodes[grandparent].right : nodes[grandparent].left;
+        if (nodes[uncle].red) {  // Red uncle: push the black down from the grandparent and carry on above
+            nodes[parent].red = false;  nodes[uncle].red = false;  nodes[grandparent].red = true;
+            z = grandparent;
+        }
+        else {  // Black uncle: one or two rotations fix it
+            if (z == (leftSide ? nodes[parent].right : nodes[parent].left)) {  // Bring z to the outside first
+                z = parent;
+                if (leftSide) { rotateLeft(z); } else { rotateRight(z); }
+                parent = nodes[z].parent;
             }
+            nodes[parent].red = false;  nodes[grandparent].red = true;
+            if (leftSide) { rotateRight(grandparent); } else { rotateLeft(grandparent); }
         }
     }
+    nodes[root].red = false;
 }
 
-void scheduleMLFQ(PCB** ready, PCB** running, PCB** waiting, PCB** terminated) { // SCHEDULER - MultiLevel Feedback Queue scheduling simulation
-    if (ready != NULL && running != NULL && waiting != NULL && terminated != NULL) { // If the double pointers to the pre-initialized lists are valid, proceed:
-        int idleTime = 0; // initialize integer idleTime to keep track of how long the cpu is idle (no running processes, or *running = null)
-        for (int t = 0; t <= 1024; t++) {  // TIME loop - time units t
-            //bool runstart = false; 
-            if (*waiting != NULL) {  // If there is at least one process in the waiting list:   (or not null)
-                (*waiting)->waitManage(waiting, ready);  // call wait manage to manage the waiting list
-            } // next:
-            if (*running != NULL) { // If there is a process running:
-                (*running)->cpuManageMLFQ(ready, running, waiting, terminated, t);   // Call cpuManageMLFQ to determine what to do with the running process
-            } // next:
-            if (*ready != NULL) {  // If there is a process in ready queue:
-                if (*running == NULL) { // If not running anything
-                    if ((*ready)->getFirstPriority(1) != NULL) { // Get the first priority 1 process
-                        if ((*ready)->getFirstPriority(1)->remainingBurst() <= 0) { ((*ready)->getFirstPriority(1))->incrementPC(); } // If the burst is up, increment program counter
-                        ((*ready)->getFirstPriority(1))->runProcess(ready, running, t); // Run the process
-                    } // If there is no priority 1 process: 
-                    else if ((*ready)->getFirstPriority(2) != NULL) { // Get the first priority 2 process
-                        if (((*ready)->getFirstPriority(2))->remainingBurst() <= 0) { ((*ready)->getFirstPriority(2))->incrementPC(); } // If the burst is up, increment program counter
-                        ((*ready)->getFirstPriority(2))->runProcess(ready, running, t); // Run the process
-                    } // If there is no priority 2 process:
-                    else { //Priority 3:  (and above 3, although processes should never go above priority value 3)
-                        if ((*ready)->remainingBurst() <= 0) { (*ready)->incrementPC(); } // If the burst is up, increment program counter
-                        (*ready)->runProcess(ready, running, t); // Run the process
-                    }
-                }
-                cout << "\n[MLFQ] Current Execution time: " << t << endl;   // Print scheduler type, and the current exec time
-                (*running)->printStatus();  // Print the status of the process currently running
-                if (*ready != NULL) { cout << "Ready:" << endl; (*ready)->printStatus(); } // If something in ready list, call recursive print status on list head to print the whole list
-                if (*waiting != NULL) { cout << "Waiting:" << endl; (*waiting)->printStatus(); } // If something in waiting list, call recursive print status on list head to print the whole list
-                if (*terminated != NULL) { cout << "Terminated:" << endl; (*terminated)->printStatus(); } // If something in terminated list, call recursive print status on list head to print the whole list
-            }
-            if (*ready == NULL && *waiting == NULL && *running == NULL) {  // If all queues are finished then print final table and end loop
-                if (*terminated != NULL) {  // If things in terminated list:
-                    cout << "\nMLFQ Results\nTotal time: " << (t-1) << "  CPU Utilization: " << (1 - (float)idleTime / (t-1)) * 100 << "%" << endl; // Print the scheduler type, total time taken, and CPU utilization
-                    (*terminated)->printTable(*terminated, 0);// Then print all of the processes in table (in terminated list)
-                } // Finished
-                return;
-            }
-            else { // Otherwise:   (if the lists are not empty) 
-                if (*running == NULL) { idleTime++; }  // If there is nothing running, increment the idleTime var
-                else { (*running)->decrementTQ(); } // Otherwise (if something is running) call decrement tq to decrement the time quantum every time unit that it runs
-                programCounter(*ready, *running, *waiting); // Increment the waiting, cpu, and io times  // Increment the waiting, cpu, and io times
+void VruntimeTree::deleteFixup(int x) {
+    while (x != root && !nodes[x].red) {  // x carries an extra black that has to be moved up or absorbed
+        int parent = nodes[x].parent;
+        bool leftSide = x == nodes[parent].left;
+        int sibling = leftSide ? nodes[parent].right : nodes[parent].left;
+        if (nodes[sibling].red) {  // Red sibling: rotate so the sibling is black
+            nodes[sibling].red = false;  nodes[parent].red = true;
+            if (leftSide) { rotateLeft(parent); } else { rotateRight(parent); }
+            sibling = leftSide ? nodes[parent].right : nodes[parent].left;
+        }
+        int nearChild = leftSide ? nodes[sibling].left : nodes[sibling].right;
+        int farChild = leftSide ? nodes[sibling].right : nodes[sibling].left;
+        if (!nodes[nearChild].red && !nodes[farChild].red) {  // Both nephews black: take a black off the sibling and move up
+            nodes[sibling].red = true;
+            x = parent;
+        }
+        else {
+            if (!nodes[farChild].red) {  // Make the far nephew red
+                nodes[nearChild].red = false;  nodes[sibling].red = true;
+                if (leftSide) { rotateRight(sibling); } else { rotateLeft(sibling); }
+                sibling = leftSide ? nodes[parent].right : nodes[parent].left;
+                farChild = leftSide ? nodes[sibling].right : nodes[sibling].left;
             }
+            nodes[sibling].red = nodes[parent].red;  nodes[parent].red = false;  nodes[farChild].red = false;
+            if (leftSide) { rotateLeft(parent); } else { rotateRight(parent); }
+            x = root;
         }
     }
+    nodes[x].red = false;
 }
 
-void runSimulation(string scheduler) { // Function to call a scheduler simulation, using fresh list pointers and data each time called
-    // Create the states of OS
-    PCB* readyList = nullptr; // first PCB of the ready list
-    PCB* runningList = nullptr; // PCB that is currently running in the CPU
-    PCB* waitingList = nullptr; // PCB waiting list
-    PCB* terminatedList = nullptr; // terminated processes
 
-    // Create the process data inputs for process CPU bursts and I/O times
-    int P1[] = { 5, 27, 3, 31, 5, 43, 4, 18, 6, 22, 4, 26, 3, 24, 5 };
-    int P2[] = { 4, 48, 5, 44, 7, 42, 12, 37, 9, 76, 4, 41, 9, 31, 7, 43, 8 };
-    int P3[] = { 8, 33, 12, 41, 18, 65, 14, 21, 4, 61, 15, 18, 14, 26, 5, 31, 6 };
-    int P4[] = { 3, 35, 4, 41, 5, 45, 3, 51, 4, 61, 5, 54, 6, 82, 5, 77, 3 };
-    int P5[] = { 16, 24, 17, 21, 5, 36, 16, 26, 7, 31, 13, 28, 11, 21, 6, 13, 3, 11, 4 };
-    int P6[] = { 11, 22, 4, 8, 5, 10, 6, 12, 7, 14, 9, 18, 12, 24, 15, 30, 8 };
-    int P7[] = { 14, 46, 17, 41, 11, 42, 15, 21, 4, 32, 7, 19, 16, 33, 10 };
-    int P8[] = { 4, 14, 5, 33, 6, 51, 14, 73, 16, 87, 6 };
 
-    // Create array of PCBs from process data
-    PCB pcbArray[] = { // Use explicit value constructor to pass the process ID number, the array of CPU/IO bursts, and the data array size, respectively
-        PCB(1,P1,sizeof(P1) / sizeof(P1[0])),
-        PCB(2,P2,sizeof(P2) / sizeof(P2[0])),
-        PCB(3,P3,sizeof(P3) / sizeof(P3[0])),
-        PCB(4,P4,sizeof(P4) / sizeof(P4[0])),
-        PCB(5,P5,sizeof(P5) / sizeof(P5[0])),
-        PCB(6,P6,sizeof(P6) / sizeof(P6[0])),
-        PCB(7,P7,sizeof(P7) / sizeof(P7[0])),
-        PCB(8,P8,sizeof(P8) / sizeof(P8[0]))
-    };
-    // Use for-loop to go through the array of PCBs and admit each into the ready list
-    for (int i = 0; i < sizeof(pcbArray) / sizeof(pcbArray[0]); i++) { (pcbArray[i]).admitProcess(&readyList); }
-    // Run the scheduler passed in the scheduler string input, with the list pointer addresses passed in:
-    if (scheduler == "SJF") {
-        scheduleSJF(&readyList, &runningList, &waitingList, &terminatedList);
-    }
-    else if (scheduler == "FCFS") {
-        scheduleFCFS(&readyList, &runningList, &waitingList, &terminatedList);
-    }
-    else if (scheduler == "MLFQ") {
-        scheduleMLFQ(&readyList, &runningList, &waitingList, &terminatedList);
-    }
-    else { cout << "\nInvalid scheduling type! (check main)\nValid types are:\nSJF\nFCFS\nMLFQ\n"; }
- 
-    return;
+MLFQConfig makeMLFQConfig(int levels) { // Builds a config with the given number of levels: quanta start at 5 and double at each level, and the last level runs to completion
+    MLFQConfig config;
+    config.levels = levels;      // Number of levels
+    config.boostInterval = 0;   // No priority boost unless asked for
+    for (int i = 0; i < levels; i++) { config.quanta.push_back(i == levels - 1 ? 0 : 5 << (i < 20 ? i : 20)); }  // 5, 10, 20, ... then 0 on the last level
+    return config;  // The default 3 levels give the original quanta of 5, 10 and run to completion
 }
 
+bool validMLFQConfig(const MLFQConfig& config) { // Checks that a config can be run, printing why not if it can't
+    if (config.levels < 1 || config.levels > 64) { cout << "MLFQ needs 1 to 64 levels (got " << config.levels << ")" << endl; return false; }  // Levels must fit in the 64 bit non-empty mask
+    if ((int)config.quanta.size() != config.levels) { cout << "MLFQ needs one quantum per level (got " << config.quanta.size() << " for " << config.levels << " levels)" << endl; return false; }
+    for (int i = 0; i < config.levels; i++) { if (config.quanta[i] < 0) { cout << "MLFQ quanta can not be negative" << endl; return false; } }
+    if (config.boostInterval < 0) { cout << "MLFQ boost interval can not be negative" << endl; return false; }
+    return true;  // Config is usable
+}
 
-int main()
-{
-    // Do three simulations, one for each scheduler:
-    runSimulation(string("SJF"));
-    runSimulation(string("FCFS"));
-    runSimulation(string("MLFQ"));
-    return 0;
-}
\ No newline at end of file
+
+void MLFQQueues::push(PCB* pcb) {  // Adds a process to the end of its level - O(1)
+    int level = pcb->getPriority() - 1;  // Priority 1 is level 0
+    pcb->setpcbPointer(NULL);           // It will be the last PCB of the level
+    if (heads[level] == NULL) { heads[level] = pcb; nonEmpty |= (uint64_t)1 << level; }  // If the level was empty it is now the head, and the level is marked as non-empty
+    else { tails[level]->setpcbPointer(pcb); }  // Otherwise link it after the current tail
+    tails[level] = pcb;  // It is the new tail
+    count++;
+}
+
+void MLFQQueues::remove(PCB* pcb) {  // Takes a process out of its level - O(1) for the head of the level
+    int level = pcb->getPriority() - 1;  // Level the process is in
+    PCB* before = NULL;  // PCB linked to this one (stays NULL if it is the head)
+    PCB* p = heads[level];
+    while (p != NULL && p != pcb) { before = p; p = p->getpcbPointer(); }  // Only walks the level if the process is not the head
+    if (p == NULL) { return; }  // Not in this level
+    if (before == NULL) { heads[level] = pcb->getpcbPointer(); } else { before->setpcbPointer(pcb->getpcbPointer()); }  // Mend the list around it
+    if (tails[level] == pcb) { tails[level] = before; }  // If it was the tail, the PCB before it is the new tail
+    if (heads[level] == NULL) { nonEmpty &= ~((uint64_t)1 << level); }  // If the level is now empty, clear its bit
+    pcb->setpcbPointer(NULL);
+    count--;
+}
+
+void MLFQQueues::boost(int quantum) {  // Moves every ready process to the top level - O(number of processes moved)
+    for (int level = 1; level < (int)heads.size(); level++) {  // Go through every level below the top, highest first
+        if (heads[level] == NULL) { continue; }  // Skip empty levels
+        for (PCB* p = heads[level]; p != NULL; p = p->getpcbPointer()) { p->setPriority(1, quantum); }  // Each process gets priority 1 and the top level quantum
+        if (heads[0] == NULL) { heads[0] = heads[level]; } else { tails[0]->setpcbPointer(heads[level]); }  // Join the whole level onto the end of the top level
+        tails[0] = tails[level];
+        heads[level] = NULL; tails[level] = NULL;  // The level is now empty
+    }
+    nonEmpty = count > 0 ? 1 : 0;  // Only the top level can have processes now
+}
+
+void MLFQQueues::collect(vector<PCB*>* out) {
+    for (int level = 0; level < (int)heads.size(); level++) { for (PCB* p = heads[level]; p != NULL; p = p->getpcbPointer()) { out->push_back(p); } }
+}
+
+void MLFQQueues::printStatus(int time) {  // Prints every ready process
+    for (int level = 0; level < (int)heads.size(); level++) { if (heads[level] != NULL) { heads[level]->printStatus(time); } }  // Recursive printStatus goes through each level list
+}
+
+// Workloads: //
+
+struct WorkloadHeader { // Header at the start of a binary workload file - followed by processCount + 1 uint64 offsets (index of each process's first burst, then burstCount), processCount int32 arrival times (version 2 on) and then burstCount int32 bursts, all little endian
+    char magic[8];          // "SCHEDWL1" - marks the file as a workload
+    uint32_t version;       // Format version, currently 2 (version 1 files have no arrival times - every process arrives at t=0)
+    uint32_t processCount;  // Number of processes in the file
+    uint64_t burstCount;    // Number of bursts of all processes together
+};
+
+const char WORKLOAD_MAGIC[8] = { 'S', 'C', 'H', 'E', 'D', 'W', 'L', '1' }; // Magic bytes at the start of every workload file
+const uint32_t WORKLOAD_VERSION = 2;  // Version written by the converter
+
+struct ImportConfig { // How a Linux scheduler trace is turned into processes (--import-unit and --import-split)
+    int unit;   // Microseconds per time unit - bursts are rounded to whole units
+    int split;  // A task that sleeps for longer than this many time units, or has been one process for this long, carries on as a new process - so only the tasks of a window this long are ever held in memory
+};
+
+class Workload // Class Workload holds the CPU/IO burst data of every process - either the built in sample processes or a binary workload file mapped into memory, so loading takes no copying - or else the text stream the processes arrive on
+{
+public:
+    Workload() { data = NULL; offsets = NULL; arrivals = NULL; count = 0; mapping = NULL; mappingSize = 0; input = NULL; traceInput = false; }  // Default constructor starts with no processes
+    ~Workload() { close(); }  // Unmaps the file, if one is open
+    Workload(const Workload&) = delete;             // Can not be copied, since it may own a mapping
+    Workload& operator=(const Workload&) = delete;
+
+    bool open(string path);  // Maps a binary workload file into memory, returning false (with a message) if it can't be used
+    void useSample();       // Uses the 8 sample processes P1-P8
+    bool openStream(string path);  // Reads processes from a text stream ("-" for stdin) as they arrive instead, returning false (with a message) if it can't be opened
+    bool openTrace(string path, const ImportConfig& config);  // Same, but the stream is a Linux scheduler trace to rebuild the processes from
+    void close();          // Unmaps the file (or drops the sample data, or closes the stream)
+    int processCount() { return count; }  // Number of processes (0 for a stream)
+    const int* bursts(int i) { return data + offsets[i]; }  // First burst of process i (0 based) - points into the mapping
+    int burstCount(int i) { return (int)(offsets[i + 1] - offsets[i]); }  // Number of bursts of process i
+    int arrival(int i) { return arrivals == NULL ? 0 : arrivals[i]; }  // Arrival time of process i
+    bool streaming() { return input != NULL; }  // True if the processes come from a stream
+    istream* stream() { return input; }        // The stream (NULL if not streaming)
+    bool importsTrace() { return traceInput; }  // True if the stream is a Linux scheduler trace
+    const ImportConfig& importConfig() { return traceConfig; }  // and how to rebuild its processes
+
+private:
+    const int* data;          // All bursts, process after process
+    const uint64_t* offsets; // Index in data of each process's first burst, plus the total at the end
+    const int* arrivals;    // Arrival time of each process (NULL = every process arrives at t=0)
+    int count;              // Number of processes
+    void* mapping;         // Start of the mapped file (NULL for the sample)
+    size_t mappingSize;   // Size of the mapped file
+    vector<int> sampleData;          // Burst storage for the sample processes
+    vector<uint64_t> sampleOffsets; // Offset storage for the sample processes
+    istream* input;        // Stream the processes arrive on (NULL unless streaming)
+    ifstream streamFile;  // File or named pipe opened for the stream (unused for stdin)
+    bool traceInput;           // True if the stream is a Linux scheduler trace rather than a text workload
+    ImportConfig traceConfig; // How to rebuild the processes of the trace
+};
+
+bool validTables(const uint64_t* offsets, uint32_t count, uint64_t bursts, const int* arrivals, const int* data) { // True if the offset table of a workload file starts at 0 and ends at bursts, with an odd number of bursts per process, every burst is at least 1, and the arrival times (if there are any) are in order from 0 on - the same rules --convert writes by, so a patched or damaged file can't send a PCB outside the mapping
+    if (offsets[0] != 0 || offsets[count] != bursts) { return false; }
+    for (uint64_t i = 0; i < bursts; i++) { if (data[i] < 1) { return false; } }
+    for (uint32_t i = 0; i < count; i++) {
+        if (offsets[i + 1] <= offsets[i] || offsets[i + 1] > bursts || (offsets[i + 1] - offsets[i]) % 2 == 0) { return false; }  // Every process starts and ends with a CPU burst
+        if (arrivals != NULL && (arrivals[i] < 0 || (i > 0 && arrivals[i] < arrivals[i - 1]))) { return false; }
+    }
+    return true;
+}
+
+bool Workload::open(string path) {  // Maps the file read only - the bursts stay in the page cache and are read in place by the PCBs
+    close();  // Drop whatever was loaded before
+    int fd = ::open(path.c_str(), O_RDONLY);  // Open the file
+    if (fd < 0) { cout << "Could not open workload " << path << endl; return false; }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(WorkloadHeader)) { cout << "Workload " << path << " is too small" << endl; ::close(fd); return false; }
+    void* p = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);  // Map the whole file
+    ::close(fd);  // The mapping stays valid after the file is closed
+    if (p == MAP_FAILED) { cout << "Could not map workload " << path << endl; return false; }
+    const WorkloadHeader* header = (const WorkloadHeader*)p;  // Header is at the start of the file
+    bool timed = header->version >= 2;  // Version 2 files have an arrival time table
+    uint64_t expected = sizeof(WorkloadHeader) + ((uint64_t)header->processCount + 1) * sizeof(uint64_t) + ((timed ? header->processCount : 0) + header->burstCount) * sizeof(int);  // Size the header says the file should be
+    const uint64_t* table = (const uint64_t*)((const char*)p + sizeof(WorkloadHeader));  // Offset table follows the header
+    if (memcmp(header->magic, WORKLOAD_MAGIC, sizeof(WORKLOAD_MAGIC)) != 0 || header->version < 1 || header->version > WORKLOAD_VERSION) { cout << "Workload " << path << " is not a version 1 to " << WORKLOAD_VERSION << " workload file" << endl; }
+    else if (header->burstCount > (uint64_t)info.st_size / sizeof(int) || expected != (uint64_t)info.st_size || !validTables(table, header->processCount, header->burstCount, timed ? (const int*)(table + header->processCount + 1) : NULL, (const int*)(table + header->processCount + 1) + (timed ? header->processCount : 0))) { cout << "Workload " << path << " is truncated or corrupt" << endl; }
+    else {  // File is usable:
+        mapping = p;  mappingSize = (size_t)info.st_size;  // Keep the mapping until close
+        count = (int)header->processCount;
+        offsets = table;
+        arrivals = timed ? (const int*)(table + count + 1) : NULL;  // Arrival times follow the offset table
+        data = (const int*)(table + count + 1) + (timed ? count : 0);  // and the bursts follow them
+        return true;
+    }
+    munmap(p, (size_t)info.st_size);  // Not usable - unmap it again
+    return false;
+}
+
+void Workload::useSample() {  // The 8 processes of the original assignment
+    close();  // Drop whatever was loaded before
+    // Create the process data inputs for process CPU bursts and I/O times
+    int P1[] = { 5, 27, 3, 31, 5, 43, 4, 18, 6, 22, 4, 26, 3, 24, 5 };
+    int P2[] = { 4, 48, 5, 44, 7, 42, 12, 37, 9, 76, 4, 41, 9, 31, 7, 43, 8 };
+    int P3[] = { 8, 33, 12, 41, 18, 65, 14, 21, 4, 61, 15, 18, 14, 26, 5, 31, 6 };
+    int P4[] = { 3, 35, 4, 41, 5, 45, 3, 51, 4, 61, 5, 54, 6, 82, 5, 77, 3 };
+    int P5[] = { 16, 24, 17, 21, 5, 36, 16, 26, 7, 31, 13, 28, 11, 21, 6, 13, 3, 11, 4 };
+    int P6[] = { 11, 22, 4, 8, 5, 10, 6, 12, 7, 14, 9, 18, 12, 24, 15, 30, 8 };
+    int P7[] = { 14, 46, 17, 41, 11, 42, 15, 21, 4, 32, 7, 19, 16, 33, 10 };
+    int P8[] = { 4, 14, 5, 33, 6, 51, 14, 73, 16, 87, 6 };
+    const int* arrays[] = { P1, P2, P3, P4, P5, P6, P7, P8 };  // Each process's bursts
+    int sizes[] = { sizeof(P1) / sizeof(P1[0]), sizeof(P2) / sizeof(P2[0]), sizeof(P3) / sizeof(P3[0]), sizeof(P4) / sizeof(P4[0]),
+                    sizeof(P5) / sizeof(P5[0]), sizeof(P6) / sizeof(P6[0]), sizeof(P7) / sizeof(P7[0]), sizeof(P8) / sizeof(P8[0]) };  // and how many there are
+    sampleOffsets.push_back(0);  // First process starts at burst 0
+    for (int i = 0; i < 8; i++) {  // Pack the arrays one after another, the same layout as a workload file
+        sampleData.insert(sampleData.end(), arrays[i], arrays[i] + sizes[i]);
+        sampleOffsets.push_back(sampleData.size());
+    }
+    data = sampleData.data();  offsets = sampleOffsets.data();  count = 8;
+}
+
+bool Workload::openStream(string path) {  // Nothing is read until the simulation asks for the first arrival
+    close();  // Drop whatever was loaded before
+    if (path == "-") { input = &cin;  return true; }
+    streamFile.open(path.c_str());  // A named pipe blocks here until something opens it for writing
+    if (!streamFile) { cout << "Could not open stream " << path << endl; return false; }
+    input = &streamFile;
+    return true;
+}
+
+bool Workload::openTrace(string path, const ImportConfig& config) {
+    if (!openStream(path)) { return false; }
+    traceInput = true;  traceConfig = config;
+    return true;
+}
+
+void Workload::close() {  // Releases the current data
+    if (mapping != NULL) { munmap(mapping, mappingSize); }  // Unmap the file if one was mapped
+    mapping = NULL;  mappingSize = 0;
+    data = NULL;  offsets = NULL;  arrivals = NULL;  count = 0;
+    sampleData.clear();  sampleOffsets.clear();
+    if (streamFile.is_open()) { streamFile.close(); }
+    input = NULL;  traceInput = false;
+}
+
+int parseArrival(const string& line) { // Reads the arrival time in the label of a line of a text workload ("P1@40: 5, 27, 3" or "@40: 5 27 3"), returning -1 if it has none
+    size_t colon = line.find(':'), at = line.find('@');
+    if (colon == string::npos || at == string::npos || at > colon) { return -1; }
+    return atoi(line.c_str() + at + 1);
+}
+
+int parseBursts(const string& line, vector<int>* bursts) { // Reads the bursts on one line of a text workload ("5, 27, 3" or "P1: 5 27 3" - anything up to a ':' is a label, '#' starts a comment), returning how many there are, or -1 if one is not a whole number from 1 to INT32_MAX
+    size_t i = line.find(':');  // Skip an optional label
+    i = (i == string::npos) ? 0 : i + 1;
+    int found = 0;  // Number of bursts on the line
+    while (i < line.size() && line[i] != '#') {  // Until the end of the line or a comment
+        if (line[i] == '-' && i + 1 < line.size() && line[i + 1] >= '0' && line[i + 1] <= '9') { return -1; }  // Negative
+        if (line[i] >= '0' && line[i] <= '9') {  // Start of a number
+            long long value = 0;
+            while (i < line.size() && line[i] >= '0' && line[i] <= '9') {  // Read its digits
+                value = value * 10 + (line[i] - '0');  i++;
+                if (value > INT32_MAX) { return -1; }  // Too long for a burst
+            }
+            if (value == 0) { return -1; }  // Every burst takes some time
+            if (bursts != NULL) { bursts->push_back((int)value); }  // Save it if asked to
+            found++;
+        }
+        else { i++; }  // Commas, spaces and tabs separate the numbers
+    }
+    return found;
+}
+
+bool convertWorkload(string textPath, string binaryPath) { // Converts a text workload (one process per line of CPU/IO bursts) into a binary workload file - two passes, so only the offset table is kept in memory
+    ifstream in(textPath.c_str());  // First pass: count the bursts of each process
+    if (!in) { cout << "Could not open " << textPath << endl; return false; }
+    vector<uint64_t> table(1, 0);  // Offset of each process's first burst, then the total
+    vector<int> arrivals;         // Arrival time of each process
+    string line;
+    for (int lineNumber = 1; getline(in, line); lineNumber++) {
+        int n = parseBursts(line, NULL);  // Count only
+        if (n < 0) { cout << "Line " << lineNumber << " of " << textPath << " has a burst that is not a whole number from 1 to " << INT32_MAX << endl; return false; }
+        if (n == 0) { continue; }  // Blank or comment line
+        if (n % 2 == 0) { cout << "Process " << table.size() << " in " << textPath << " has an even number of bursts - it must start and end with a CPU burst" << endl; return false; }
+        int arrival = parseArrival(line);  // A process with no arrival time arrives with the one before
+        if (arrival < 0) { arrival = arrivals.empty() ? 0 : arrivals.back(); }
+        if (!arrivals.empty() && arrival < arrivals.back()) { cout << "Process " << table.size() << " in " << textPath << " arrives before the process above it - processes must be in arrival order" << endl; return false; }
+        table.push_back(table.back() + n);
+        arrivals.push_back(arrival);
+    }
+    FILE* out = fopen(binaryPath.c_str(), "wb");  // Write the header and offset table
+    if (out == NULL) { cout << "Could not create " << binaryPath << endl; return false; }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);  // Large buffer since the bursts are written one line at a time
+    WorkloadHeader header;
+    memcpy(header.magic, WORKLOAD_MAGIC, sizeof(WORKLOAD_MAGIC));
+    header.version = WORKLOAD_VERSION;
+    header.processCount = (uint32_t)(table.size() - 1);
+    header.burstCount = table.back();
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(table.data(), sizeof(uint64_t), table.size(), out);
+    fwrite(arrivals.data(), sizeof(int), arrivals.size(), out);
+    in.clear();  in.seekg(0);  // Second pass: write the bursts
+    vector<int> bursts;
+    while (getline(in, line)) {
+        bursts.clear();
+        if (parseBursts(line, &bursts) > 0) { fwrite(bursts.data(), sizeof(int), bursts.size(), out); }
+    }
+    bool ok = !ferror(out);  // Check every write went through
+    if (fclose(out) != 0) { ok = false; }
+    if (!ok) { cout << "Could not write " << binaryPath << endl; return false; }
+    cout << "Wrote " << header.processCount << " processes (" << header.burstCount << " bursts) to " << binaryPath << endl;
+    return true;
+}
+
+class TraceImporter // Class TraceImporter reads a Linux scheduler trace - sched_switch and sched_wakeup events as ftrace, trace-cmd report or perf sched script print them - and rebuilds each task's CPU and IO bursts, handing the tasks out as processes in arrival order while the trace is still being read
+{
+public:
+    TraceImporter() { input = NULL; }
+    void begin(istream* iinput, const ImportConfig& iconfig);  // Starts reading a trace from the stream
+    bool next(vector<int>* bursts, int* arrival, string* name);  // Reads on until the next process is complete, filling in its bursts, arrival time and task name ("comm-pid", if name is not NULL) - returns false at the end of the trace
+    long long eventCount() { return events; }  // Scheduling events read so far
+    long long lineCount() { return lines; }   // Lines read so far
+
+private:
+    enum Kind { SWITCH, WAKEUP, EXIT };  // Events that change what a task is doing
+    enum State { RUNNING, READY, BLOCKED, DONE };  // What a task is doing - READY is runnable but not on a CPU (preempted, or woken and not yet run), which the simulated scheduler decides for itself
+    struct Task {  // One task of the trace, or one part of it once it has been split
+        int pid;
+        string comm;       // Name of the task, as the trace last gave it
+        int64_t arrival;  // Time it was first seen (ns)
+        int64_t since;   // Time it started running, or blocked (ns)
+        int64_t cpu;    // Time on a CPU so far in its current CPU burst, across preemptions (ns)
+        State state;
+        vector<int> bursts;  // CPU and IO bursts so far, in time units
+    };
+    istream* input;          // Trace being read
+    ImportConfig config;
+    int64_t unit;           // Nanoseconds per time unit
+    int64_t split;         // config.split in nanoseconds
+    int64_t origin;       // Time of the first event (ns, -1 until it is read) - arrivals are counted from here
+    int64_t now;         // Time of the last event (ns) - never goes back
+    int lastArrival;    // Arrival of the last process handed out
+    long long lines, events;
+    bool ended;          // True once the end of the trace is reached
+    deque<Task> tasks;   // Tasks not yet handed out, in arrival order - a process can only be handed out once every task that arrived before it has been
+    unordered_map<int, Task*> alive;  // Task of each pid still being followed (points into tasks, which never moves them)
+    string line;        // Line being parsed, and what was found on it:
+    Kind kind;
+    int64_t time;
+    int pid, nextPid;
+    string comm, nextComm, prevState;
+
+    bool readEvent();  // Reads lines until one holds a scheduling event and applies it, returning false at the end of the trace
+    bool parse();     // Parses line into the fields above, returning false if it is not a scheduling event
+    bool compactTask(size_t from, size_t to, int* ipid, string* icomm, size_t* after);  // Reads "comm:pid [prio]" in line between from and to
+    string field(const char* key, const char* end, size_t from);  // Text after key up to end (or the next space), searching line from from
+    int fieldInt(const char* key, size_t from) { size_t k = line.find(key, from); return k == string::npos ? -1 : atoi(line.c_str() + k + strlen(key)); }
+    Task* find(int ipid) { unordered_map<int, Task*>::iterator it = alive.find(ipid); return it == alive.end() ? NULL : it->second; }
+    Task* start(int ipid, const string& icomm, int64_t at, State state);  // Starts following a task, as a new process arriving at time at
+    void wake(int ipid, const string& icomm);
+    void switchOut(int ipid, const string& icomm, const string& state);
+    void switchIn(int ipid, const string& icomm);
+    void finish(Task* t);  // Ends the process of a task at the current time - it is handed out once the processes before it have been
+    void cut(Task* t);    // Finishes a task that has been a process for longer than config.split - one still running or ready carries on as a new process, a sleeping one arrives again when it wakes
+    void addCPU(Task* t, int64_t ns);  // Adds a CPU burst, or adds onto the last one if the IO burst between them was missed
+    void addIO(Task* t, int64_t ns);  // Adds an IO burst after a CPU burst (dropped if there is no CPU burst before it)
+    int units(int64_t ns) { int64_t u = (ns + unit / 2) / unit; return u < 1 ? 1 : (u > 1000000000 ? 1000000000 : (int)u); }  // Rounded to the nearest time unit - at least 1, and capped so times can't overflow
+};
+
+void TraceImporter::begin(istream* iinput, const ImportConfig& iconfig) {
+    input = iinput;  config = iconfig;
+    unit = (int64_t)config.unit * 1000;  split = (int64_t)config.split * unit;
+    origin = -1;  now = 0;  lastArrival = 0;  lines = 0;  events = 0;  ended = false;
+    tasks.clear();  alive.clear();
+}
+
+bool TraceImporter::next(vector<int>* bursts, int* arrival, string* name) {
+    while (true) {
+        while (!tasks.empty() && tasks.front().state != DONE && now - tasks.front().arrival > split) { cut(&tasks.front()); }  // The oldest process is cut when it gets too long, so a task that never ends doesn't hold back every process after it
+        if (!tasks.empty() && tasks.front().state == DONE) {  // Oldest process is complete - hand it out
+            Task& t = tasks.front();
+            bool ran = !t.bursts.empty();  // A task that never ran has no process
+            if (ran) {
+                bursts->swap(t.bursts);
+                int at = (int)min((t.arrival - origin) / unit, (int64_t)1000000000);
+                lastArrival = *arrival = max(at, lastArrival);  // Only a task running since the start of the trace, and found after a later one was handed out, can arrive before the last one
+                if (name != NULL) { *name = t.comm + "-" + to_string(t.pid); }
+            }
+            tasks.pop_front();
+            if (ran) { return true; }
+            continue;
+        }
+        if (ended) { return false; }  // Every task has been handed out
+        if (!readEvent()) {  // End of the trace - whatever is still going ends here
+            ended = true;
+            for (size_t i = 0; i < tasks.size(); i++) { if (tasks[i].state != DONE) { finish(&tasks[i]); } }
+        }
+    }
+}
+
+bool TraceImporter::readEvent() {
+    while (getline(*input, line)) {
+        lines++;
+        if (!parse()) { continue; }  // Header, comment or some other event
+        if (origin < 0) { origin = now = time; }
+        if (time > now) { now = time; }  // Events of different CPUs can be a little out of order - time can't go back
+        if ((now - origin) / unit > 1000000000) { cout << "The trace is longer than 1000000000 time units - stopping there (use a larger --import-unit)" << endl; return false; }
+        events++;
+        if (kind == WAKEUP) { wake(pid, comm); }
+        else if (kind == EXIT) { Task* t = find(pid); if (t != NULL) { finish(t); } }
+        else { switchOut(pid, comm, prevState);  switchIn(nextPid, nextComm); }
+        return true;
+    }
+    return false;
+}
+
+bool TraceImporter::parse() {  // Key=value fields as ftrace and perf print them ("prev_comm=bash prev_pid=12 prev_prio=120 prev_state=S ==> next_comm=cc1 next_pid=40 next_prio=120"), or as trace-cmd prints them ("bash:12 [120] S ==> cc1:40 [120]")
+    static const char* names[] = { "sched_switch:", "sched_wakeup:", "sched_wakeup_new:", "sched_waking:", "sched_process_exit:" };  // perf puts "sched:" before them
+    static const Kind kinds[] = { SWITCH, WAKEUP, WAKEUP, WAKEUP, EXIT };  // A task woken by sched_waking is not woken again by the sched_wakeup after it
+    size_t at = 0, fields = string::npos;  // Start of the event name, and of its fields
+    while (fields == string::npos && (at = line.find("sched_", at)) != string::npos) {
+        for (int i = 0; i < 5 && fields == string::npos; i++) { if (line.compare(at, strlen(names[i]), names[i]) == 0) { kind = kinds[i];  fields = at + strlen(names[i]); } }
+        if (fields == string::npos) { at++; }
+    }
+    if (fields == string::npos) { return false; }
+    size_t end = at;  // The timestamp is the last "seconds.fraction:" before the event name
+    do {
+        if (end == 0) { return false; }
+        end = line.rfind(':', end - 1);
+    } while (end != string::npos && (end == 0 || line[end - 1] < '0' || line[end - 1] > '9'));
+    if (end == string::npos) { return false; }
+    size_t i = end;
+    while (i > 0 && ((line[i - 1] >= '0' && line[i - 1] <= '9') || line[i - 1] == '.')) { i--; }
+    int64_t seconds = 0, fraction = 0;
+    int digits = 0;
+    while (line[i] >= '0' && line[i] <= '9') { seconds = seconds * 10 + (line[i] - '0'); i++; }
+    if (line[i] != '.') { return false; }
+    for (i++; i < end; i++) { if (digits < 9) { fraction = fraction * 10 + (line[i] - '0');  digits++; } }  // Microseconds, or nanoseconds, depending on the tool
+    for (; digits < 9; digits++) { fraction *= 10; }
+    time = seconds * 1000000000 + fraction;
+    if (kind == SWITCH) {
+        size_t arrow = line.find(" ==> ", fields);
+        if (arrow == string::npos) { return false; }
+        if (line.find("prev_pid=", fields) < arrow) {
+            pid = fieldInt("prev_pid=", fields);  comm = field("prev_comm=", " prev_pid=", fields);  prevState = field("prev_state=", " ", fields);
+            nextPid = fieldInt("next_pid=", arrow);  nextComm = field("next_comm=", " next_pid=", arrow);
+        }
+        else {
+            size_t after;
+            if (!compactTask(fields, arrow, &pid, &comm, &after) || !compactTask(arrow + 5, line.size(), &nextPid, &nextComm, NULL)) { return false; }
+            while (after < arrow && line[after] == ' ') { after++; }
+            prevState = line.substr(after, line.find(' ', after) - after);
+        }
+        return pid >= 0 && nextPid >= 0;
+    }
+    if (line.find("comm=", fields) != string::npos) { pid = fieldInt(" pid=", fields);  comm = field("comm=", " pid=", fields); }
+    else if (!compactTask(fields, line.size(), &pid, &comm, NULL)) { return false; }
+    return pid >= 0;
+}
+
+bool TraceImporter::compactTask(size_t from, size_t to, int* ipid, string* icomm, size_t* after) {  // The pid is the number before the priority in brackets, and the name is everything before its ':', so a name may hold spaces or colons
+    size_t open = line.rfind('[', to - 1);
+    if (open == string::npos || open < from) { return false; }
+    size_t e = open, d;
+    while (e > from && line[e - 1] == ' ') { e--; }
+    for (d = e; d > from && line[d - 1] >= '0' && line[d - 1] <= '9'; d--) { }
+    if (d == e || d == from || line[d - 1] != ':') { return false; }
+    *ipid = atoi(line.c_str() + d);
+    while (from < d - 1 && line[from] == ' ') { from++; }
+    *icomm = line.substr(from, d - 1 - from);
+    if (after != NULL) { size_t close = line.find(']', open);  *after = close == string::npos ? to : close + 1; }
+    return true;
+}
+
+string TraceImporter::field(const char* key, const char* end, size_t from) {
+    size_t k = line.find(key, from);
+    if (k == string::npos) { return ""; }
+    k += strlen(key);
+    size_t e = line.find(end, k);
+    return line.substr(k, e == string::npos ? string::npos : e - k);
+}
+
+TraceImporter::Task* TraceImporter::start(int ipid, const string& icomm, int64_t at, State state) {
+    Task t;
+    t.pid = ipid;  t.comm = icomm;  t.arrival = at;  t.since = at;  t.cpu = 0;  t.state = state;
+    if (at == origin) { tasks.push_front(t); }  // Running since the start of the trace - it arrived before anything else
+    else { tasks.push_back(t); }
+    Task* p = at == origin ? &tasks.front() : &tasks.back();
+    alive[ipid] = p;
+    return p;
+}
+
+void TraceImporter::wake(int ipid, const string& icomm) {
+    if (ipid == 0) { return; }  // The idle task
+    Task* t = find(ipid);
+    if (t == NULL) { start(ipid, icomm, now, READY);  return; }  // First seen waking - it arrives now
+    if (t->state != BLOCKED) { return; }  // Already awake
+    if (now - t->since > split) { finish(t);  start(ipid, icomm, now, READY);  return; }  // Slept for too long - the rest of the task is a new process
+    addIO(t, now - t->since);
+    t->state = READY;
+}
+
+void TraceImporter::switchOut(int ipid, const string& icomm, const string& state) {  // A state starting with R is a preemption, X or Z an exit, and anything else (S, D, I ...) a block
+    if (ipid == 0) { return; }
+    bool dead = state.find_first_of("XZx") != string::npos;
+    Task* t = find(ipid);
+    if (t == NULL) {
+        if (dead) { return; }  // Already finished by sched_process_exit
+        t = start(ipid, icomm, origin, RUNNING);  // Only a task that was running when the trace started can leave a CPU without having been seen
+    }
+    if (dead) { finish(t);  return; }
+    if (t->state == RUNNING) { t->cpu += now - t->since; }
+    if (!state.empty() && state[0] == 'R') { t->state = READY;  return; }  // Preempted - the CPU burst carries on when it runs again
+    addCPU(t, t->cpu);
+    t->cpu = 0;  t->state = BLOCKED;  t->since = now;
+}
+
+void TraceImporter::switchIn(int ipid, const string& icomm) {
+    if (ipid == 0) { return; }
+    Task* t = find(ipid);
+    if (t != NULL && t->state == BLOCKED) { wake(ipid, icomm);  t = find(ipid); }  // Its wakeup was missed - it slept until now
+    if (t == NULL) { t = start(ipid, icomm, now, READY); }  // First seen running - it arrives now
+    if (t->state != RUNNING) { t->state = RUNNING;  t->since = now; }
+    t->comm = icomm;
+}
+
+void TraceImporter::finish(Task* t) {
+    if (t->state == RUNNING) { t->cpu += now - t->since; }
+    if (t->cpu > 0) { addCPU(t, t->cpu); }
+    else if (t->bursts.size() % 2 == 0 && !t->bursts.empty()) { t->bursts.pop_back(); }  // Woken but never ran again - a process ends on a CPU burst
+    t->cpu = 0;  t->state = DONE;
+    unordered_map<int, Task*>::iterator it = alive.find(t->pid);
+    if (it != alive.end() && it->second == t) { alive.erase(it); }  // A new task with its pid is a new process
+}
+
+void TraceImporter::cut(Task* t) {
+    State state = t->state;
+    finish(t);
+    if (state != BLOCKED) { Task* rest = start(t->pid, t->comm, now, state);  rest->since = now; }
+}
+
+void TraceImporter::addCPU(Task* t, int64_t ns) {
+    if (ns <= 0) { return; }
+    if (t->bursts.size() % 2 == 0) { t->bursts.push_back(units(ns)); }
+    else { t->bursts.back() = units((int64_t)t->bursts.back() * unit + ns); }
+}
+
+void TraceImporter::addIO(Task* t, int64_t ns) {
+    if (t->bursts.size() % 2 == 1) { t->bursts.push_back(units(ns)); }
+}
+
+bool importTrace(string tracePath, string outPath, const ImportConfig& config) { // Rebuilds the processes of a Linux scheduler trace and writes them out as a text workload ("-" = stdin or stdout), returning false (with a message) if it can't - one pass, holding only the tasks still being followed
+    ifstream file;
+    istream* in = &cin;
+    if (tracePath != "-") {
+        file.open(tracePath.c_str());
+        if (!file) { cout << "Could not open trace " << tracePath << endl; return false; }
+        in = &file;
+    }
+    FILE* out = outPath == "-" ? stdout : fopen(outPath.c_str(), "w");
+    if (out == NULL) { cout << "Could not create " << outPath << endl; return false; }
+    if (out != stdout) { setvbuf(out, NULL, _IOFBF, 1 << 20); }  // Large buffer since the processes are written one line at a time
+    TraceImporter importer;
+    importer.begin(in, config);
+    vector<int> bursts;
+    string name;
+    int arrival;
+    long long processes = 0, burstTotal = 0;
+    while (importer.next(&bursts, &arrival, &name)) {  // One line per process: "P1@40: 5, 27, 3  # comm-pid"
+        processes++;  burstTotal += (long long)bursts.size();
+        fprintf(out, "P%lld@%d:", processes, arrival);
+        for (size_t i = 0; i < bursts.size(); i++) { fprintf(out, i == 0 ? " %d" : ", %d", bursts[i]); }
+        fprintf(out, "  # %s\n", name.c_str());
+    }
+    fprintf(out, "# %lld processes (%lld bursts) from %lld scheduling events in %lld lines\n", processes, burstTotal, importer.eventCount(), importer.lineCount());
+    bool ok = !ferror(out);  // Check every write went through
+    if (out == stdout ? fflush(out) != 0 : fclose(out) != 0) { ok = false; }
+    if (!ok) { cout << "Could not write " << outPath << endl; return false; }
+    if (outPath != "-") { cout << "Wrote " << processes << " processes (" << burstTotal << " bursts) from " << importer.eventCount() << " scheduling events to " << outPath << endl; }
+    return true;
+}
+
+class Random // Class Random is a small seeded random number generator (splitmix64) - written out here rather than using <random> so a seed gives the same workload with every compiler
+{
+public:
+    Random(uint64_t seed) { state = seed; }  // Explicit value constructor sets the seed
+    uint64_t next() {  // Next 64 random bits
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }  // Uniform number in [0, 1)
+    double exponential(double mean) { return -mean * log(1.0 - uniform()); }  // Exponentially distributed number with the given mean
+    double normal() { return sqrt(-2.0 * log(1.0 - uniform())) * cos(6.283185307179586 * uniform()); }  // Standard normal number (Box-Muller)
+    uint64_t getState() { return state; }  // Accessor for the state var, to save it in a snapshot
+    void setState(uint64_t istate) { state = istate; }  // Mutator for the state var, to carry on from a snapshot
+
+private:
+    uint64_t state;  // Current state, advanced on every call
+};
+
+struct Distribution { // A burst length distribution, parsed from text such as "exp:8" - see parse() for the kinds
+    string kind;  // "fixed", "exp", "lognormal", "bimodal" or "pareto"
+    double a;    // First parameter (value, mean, mean, first mean, minimum)
+    double b;   // Second parameter (-, -, sigma, second mean, alpha)
+    double c;  // Third parameter (-, -, -, weight of the first mean, -)
+
+    bool parse(string text);     // Reads a distribution from text, returning false (with a message) if it can't
+    int sample(Random& random);  // Draws one burst length (at least 1)
+};
+
+bool Distribution::parse(string text) {  // fixed:V, exp:MEAN, lognormal:MEAN:SIGMA, bimodal:MEAN1:MEAN2:WEIGHT1, pareto:MIN:ALPHA
+    size_t colon = text.find(':');
+    kind = text.substr(0, colon);  // Kind is everything up to the first ':'
+    vector<double> values;  // Then the parameters, separated by ':'
+    while (colon != string::npos) {
+        size_t next = text.find(':', colon + 1);
+        values.push_back(atof(text.substr(colon + 1, next == string::npos ? string::npos : next - colon - 1).c_str()));
+        colon = next;
+    }
+    size_t needed = kind == "fixed" || kind == "exp" ? 1 : kind == "lognormal" || kind == "pareto" ? 2 : kind == "bimodal" ? 3 : 0;  // Number of parameters of each kind
+    if (needed == 0 || values.size() != needed) { cout << "Invalid distribution " << text << " (use fixed:V, exp:MEAN, lognormal:MEAN:SIGMA, bimodal:MEAN1:MEAN2:WEIGHT1 or pareto:MIN:ALPHA)" << endl; return false; }
+    a = values[0];  b = needed > 1 ? values[1] : 0;  c = needed > 2 ? values[2] : 0;
+    if (a <= 0 || (kind != "fixed" && kind != "exp" && b <= 0) || (kind == "bimodal" && (c < 0 || c > 1))) { cout << "Invalid parameters for distribution " << text << endl; return false; }
+    return true;
+}
+
+int Distribution::sample(Random& random) {  // Draws one value and rounds it to a whole number of time units
+    double value;
+    if (kind == "fixed") { value = a; }
+    else if (kind == "exp") { value = random.exponential(a); }  // Memoryless - most bursts short, a few long
+    else if (kind == "lognormal") { value = exp(log(a) - b * b / 2 + b * random.normal()); }  // Mean a, with b the sigma of the underlying normal
+    else if (kind == "bimodal") { value = random.exponential(random.uniform() < c ? a : b); }  // Mix of two exponentials, e.g. interactive and batch bursts
+    else { value = a / pow(1.0 - random.uniform(), 1.0 / b); }  // Pareto - heavy tail, smaller alpha gives longer bursts
+    if (value < 1) { return 1; }  // Every burst takes at least 1 time unit
+    if (value > 1e9) { return 1000000000; }  // and is capped so times can't overflow
+    return (int)(value + 0.5);
+}
+
+struct GeneratorConfig { // Parameters of a generated workload
+    int processes;          // Number of processes to generate (0 = don't generate, use the workload instead)
+    uint64_t seed;          // Seed - the same seed and parameters always give the same processes
+    Distribution cpu;       // Distribution of CPU burst lengths
+    Distribution io;        // Distribution of IO burst lengths
+    int minBursts;          // Fewest CPU bursts a process can have
+    int maxBursts;          // Most CPU bursts a process can have
+    bool arrivals;          // False if every process arrives at t=0
+    Distribution arrivalGap; // Otherwise, distribution of the time between one arrival and the next
+};
+
+GeneratorConfig makeGeneratorConfig() { // Default generator: exponential bursts with means close to the sample processes, all arriving at t=0
+    GeneratorConfig config;
+    config.processes = 0;
+    config.seed = 1;
+    config.cpu.parse("exp:8");
+    config.io.parse("exp:35");
+    config.minBursts = 6;
+    config.maxBursts = 10;
+    config.arrivals = false;
+    config.arrivalGap.parse("fixed:1");
+    return config;
+}
+
+class WorkloadGenerator // Class WorkloadGenerator makes processes one at a time, in arrival order, so only the processes that have arrived ever exist
+{
+public:
+    WorkloadGenerator(const GeneratorConfig& iconfig) : config(iconfig), arrivalRandom(iconfig.seed ^ 0xA5A5A5A5A5A5A5A5ULL) { made = 0; arrival = 0; }  // Explicit value constructor starts before the first process
+    bool more() { return made < config.processes; }  // True if there are processes left to make
+    int nextArrival() { return arrival; }           // Arrival time of the next process
+    void generate(vector<int>* bursts);            // Makes the next process's bursts, and moves on to the process after
+    uint64_t make(int* count);                    // Makes the next process without its bursts - sets count to its number of bursts and returns the state of its random numbers to draw them from with burst() - and moves on to the process after
+    int burst(uint64_t* random, int index);      // Draws burst index of a process (CPU bursts are even, IO bursts odd) from the state of its random numbers, moving the state on
+    uint64_t randomAt(int process, int index);  // State of the random numbers of process number process (0 on) once its bursts up to index are drawn (-1 for none)
+    void bursts(int process, vector<int>* out);  // Adds every burst of process number process (0 on) to the end of out
+    void save(Snapshot* s);            // Saves how far the generator has got in a snapshot
+    void restore(const Snapshot& s);  // Carries on from where a snapshot says the generator had got to
+
+private:
+    GeneratorConfig config;  // Parameters of the workload
+    Random arrivalRandom;   // Random numbers for the arrival times (separate so they don't depend on the bursts)
+    int made;              // Number of processes made so far
+    int arrival;          // Arrival time of the next process
+    Random start(int process, int* count);  // Random numbers of process number process (0 on), with its number of bursts drawn
+};
+
+thread_local WorkloadGenerator* activeGenerator = NULL;  // Generator that the generated processes on this thread make their bursts with (set by ProcessStream as it makes them)
+
+Random WorkloadGenerator::start(int process, int* count) {  // Each process has its own seed, made from the workload seed and its number, so any process comes out the same however the rest are made - and any of its bursts can be drawn again later
+    Random random(config.seed * 0x9E3779B97F4A7C15ULL + (uint64_t)process);  // Seed for this process
+    int cpuBursts = config.minBursts + (int)(random.uniform() * (config.maxBursts - config.minBursts + 1));  // Number of CPU bursts
+    *count = 2 * cpuBursts - 1;  // Alternate CPU and IO bursts, starting and ending with CPU
+    return random;
+}
+
+int WorkloadGenerator::burst(uint64_t* random, int index) {  // Bursts are drawn in order, so a process only has to keep the state of its random numbers
+    Random r(*random);
+    int value = index % 2 == 0 ? config.cpu.sample(r) : config.io.sample(r);
+    *random = r.getState();
+    return value;
+}
+
+uint64_t WorkloadGenerator::make(int* count) {
+    uint64_t random = start(made, count).getState();
+    made++;
+    if (config.arrivals && more()) { arrival += config.arrivalGap.sample(arrivalRandom); }  // Arrival time of the process after
+    return random;
+}
+
+void WorkloadGenerator::generate(vector<int>* bursts) {
+    int count;
+    uint64_t random = make(&count);
+    bursts->clear();
+    for (int i = 0; i < count; i++) { bursts->push_back(burst(&random, i)); }
+}
+
+uint64_t WorkloadGenerator::randomAt(int process, int index) {  // Draws the bursts again up to index - only done when a snapshot is restored
+    int count;
+    uint64_t random = start(process, &count).getState();
+    for (int i = 0; i <= index; i++) { burst(&random, i); }
+    return random;
+}
+
+void WorkloadGenerator::bursts(int process, vector<int>* out) {
+    int count;
+    uint64_t random = start(process, &count).getState();
+    for (int i = 0; i < count; i++) { out->push_back(burst(&random, i)); }
+}
+
+inline int PCB::nextBurst() {  // Defined out of the class so it can reach the generator
+    if (burstLeft > 0) { return burstLeft; }
+    if (!generatedBursts) { return processData[dataIndex + 1]; }
+    uint64_t random = burstRandom;  // Draw from a copy - the burst is drawn for real when the process reaches it
+    return activeGenerator->burst(&random, dataIndex + 1);
+}
+
+void PCB::incrementPC() {              // Increments the dataIndex, or program counter index in the array of process data (IO/CPU bursts)
+    if (dataIndex + 1 < dataSize) {   // If there is another burst in the data array
+        dataIndex++;                 // Increment the data index to the next index in the data array
+        burstLeft = generatedBursts ? activeGenerator->burst(&burstRandom, dataIndex) : processData[dataIndex];  // The whole of the new burst is left
+    }
+}
+
+void PCB::copyBursts(vector<int>* out) {
+    if (generatedBursts) { activeGenerator->bursts(processID - 1, out); }  // Generated process n is process number n - 1 of the generator
+    else { out->insert(out->end(), processData, processData + dataSize); }
+}
+
+void WorkloadGenerator::save(Snapshot* s) {
+    s->generatorMade = made;  s->generatorArrival = arrival;  s->generatorRandom = arrivalRandom.getState();
+}
+
+void WorkloadGenerator::restore(const Snapshot& s) {  // Each process's bursts come from its own seed, so only the arrivals need their random numbers carried on
+    made = s.generatorMade;  arrival = s.generatorArrival;  arrivalRandom.setState(s.generatorRandom);
+}
+
+class BurstArena // Class BurstArena holds the bursts of generated processes packed one after another in large blocks, instead of one small allocation per process
+{
+public:
+    BurstArena(bool irecycle = false) { used = 0; recycling = irecycle; }  // Default constructor starts with no blocks - irecycle rounds each process's room up to a power of two, so released room can be reused
+    const int* add(const vector<int>& bursts);  // Copies a process's bursts into the arena, returning where they are (they never move)
+    void release(const int* bursts, int count);  // Gives back the room of a terminated process's bursts, when recycling
+
+private:
+    static const size_t BLOCK = 1 << 20;  // Bursts per block (4 MB)
+    static int sizeClass(size_t n) { return n <= 1 ? 0 : 64 - __builtin_clzll(n - 1); }  // Room for n bursts is 2^sizeClass(n)
+    vector<vector<int> > blocks;  // Blocks of bursts - each is allocated once at full size, so pointers into it stay valid
+    size_t used;                 // Bursts used in the last block
+    bool recycling;             // True if room is given back and reused
+    vector<vector<int*> > freeRoom;  // Released room of each size class
+};
+
+const int* BurstArena::add(const vector<int>& bursts) {  // Reuses released room of the right size if there is some, and otherwise starts a new block when the last one is full
+    size_t room = bursts.size();
+    if (recycling) {
+        int c = sizeClass(room);
+        room = (size_t)1 << c;
+        if (c < (int)freeRoom.size() && !freeRoom[c].empty()) {
+            int* start = freeRoom[c].back();
+            freeRoom[c].pop_back();
+            copy(bursts.begin(), bursts.end(), start);
+            return start;
+        }
+    }
+    if (blocks.empty() || used + room > blocks.back().size()) {
+        blocks.push_back(vector<int>(max((size_t)BLOCK, room)));
+        used = 0;
+    }
+    int* start = blocks.back().data() + used;
+    copy(bursts.begin(), bursts.end(), start);
+    used += room;
+    return start;
+}
+
+void BurstArena::release(const int* bursts, int count) {
+    if (!recycling) { return; }  // Packed room can't be reused
+    int c = sizeClass(count);
+    if (c >= (int)freeRoom.size()) { freeRoom.resize(c + 1); }
+    freeRoom[c].push_back(const_cast<int*>(bursts));  // The arena owns the room, the PCB only reads it
+}
+
+class PCBPool // Class PCBPool is the process table - PCBs side by side in blocks that never move once the lists point at them, with terminated PCBs kept on a free list to be reused when recycling
+{
+public:
+    PCBPool(size_t expected) { used = 0; firstBlock = expected > 0 && expected < BLOCK ? expected : BLOCK; }  // expected is how many processes there will be, if known, so a small workload gets a small first block
+    PCB* take();  // A PCB to set up for a new process - a recycled one if there is one
+    void give(PCB* pcb) { freePCBs.push_back(pcb); }  // Takes back a terminated PCB
+
+private:
+    static const size_t BLOCK = 4096;  // PCBs per block
+    vector<vector<PCB> > blocks;  // Blocks of PCBs - each is allocated once at full size, so PCBs never move
+    size_t used;                 // PCBs used in the last block
+    size_t firstBlock;          // Size of the first block
+    vector<PCB*> freePCBs;     // Terminated PCBs ready to reuse
+};
+
+PCB* PCBPool::take() {
+    if (!freePCBs.empty()) { PCB* p = freePCBs.back();  freePCBs.pop_back();  return p; }
+    if (blocks.empty() || used == blocks.back().size()) {
+        blocks.push_back(vector<PCB>(blocks.empty() ? firstBlock : (size_t)BLOCK));
+        used = 0;
+    }
+    return &blocks.back()[used++];
+}
+
+class ProcessStream // Class ProcessStream hands the processes of a workload (file, sample, generated or streamed) to a scheduler in arrival order, creating each PCB only when it arrives
+{
+public:
+    ProcessStream(Workload* iworkload, bool recycle);  // Processes of a workload, or of a stream if the workload is one - recycle reuses terminated PCBs and their bursts
+    ProcessStream(const GeneratorConfig& config, bool recycle);  // Generated processes
+    bool more();  // True if there are processes still to arrive (for a stream, this waits until the next process or the end of the stream is read)
+    int nextArrival();  // Arrival time of the next process
+    PCB* create();  // Makes the PCB of the next process
+    bool recycling() { return reusing; }  // True if terminated PCBs are given back with recycle(), rather than kept
+    void recycle(PCB* pcb);  // Gives back a terminated PCB and its bursts to be reused, once its times are counted
+    int created() { return next; }  // Number of processes created so far
+    void save(Snapshot* s);  // Saves how many processes have arrived (and how far the generator has got) in a snapshot
+    vector<PCB*> restore(const Snapshot& s, PCB** waiting, PCB** terminated, vector<PCB*>* running);  // Makes the PCBs of a snapshot, adding the waiting, terminated and running ones to their lists - returns the PCB of each record (NULL for one recycled straight away), so the engine can push the ready ones into its queues
+
+private:
+    Workload* workload;           // Workload to read processes from (if not generating)
+    WorkloadGenerator generator; // Generator to make processes with (if generating)
+    bool generating;            // Which of the two is used
+    bool streaming;            // True if the workload is a stream
+    bool pending;             // True if the next process of the stream has been read into scratch
+    int pendingArrival;      // and its arrival time
+    bool reusing;           // True if terminated PCBs are reused
+    int next;              // Number of processes created so far
+    PCBPool pcbs;         // Process table
+    BurstArena arena;    // Burst data of the streamed processes (workload processes point into the workload instead, and generated processes make theirs as they go)
+    vector<int> scratch;  // Bursts of the process being read, before they go into the arena
+    TraceImporter importer;  // Rebuilds the processes of the stream, if it is a Linux scheduler trace
+    bool readProcess();  // Reads the next process of the stream into scratch, returning false at the end of the stream
+};
+
+ProcessStream::ProcessStream(Workload* iworkload, bool irecycle) : generator(makeGeneratorConfig()), pcbs(iworkload->processCount()), arena(irecycle) {
+    workload = iworkload;  generating = false;  streaming = workload->streaming();  reusing = irecycle;  next = 0;
+    pending = false;  pendingArrival = 0;  // Nothing is read from a stream until the first arrival is asked for, so a pipe can start writing after the simulation starts
+    if (streaming && workload->importsTrace()) { importer.begin(workload->stream(), workload->importConfig()); }
+}
+
+ProcessStream::ProcessStream(const GeneratorConfig& config, bool irecycle) : generator(config), pcbs(config.processes), arena(irecycle) {
+    workload = NULL;  generating = true;  streaming = false;  reusing = irecycle;  next = 0;
+    pending = false;  pendingArrival = 0;
+}
+
+bool ProcessStream::more() {
+    if (generating) { return generator.more(); }
+    if (streaming) { if (!pending) { pending = readProcess(); } return pending; }
+    return next < workload->processCount();
+}
+
+int ProcessStream::nextArrival() {
+    if (generating) { return generator.nextArrival(); }
+    if (streaming) { more();  return pendingArrival; }  // Read the next process if it hasn't been
+    return workload->arrival(next);
+}
+
+bool ProcessStream::readProcess() {  // Lines are in the text workload format, with the arrival time after an '@' in the label
+    if (workload->importsTrace()) {  // or are trace events, which the importer turns into processes
+        int arrival;
+        if (!importer.next(&scratch, &arrival, NULL)) { return false; }
+        if (arrival > pendingArrival) { pendingArrival = arrival; }
+        return true;
+    }
+    string line;
+    while (getline(*workload->stream(), line)) {
+        scratch.clear();
+        int n = parseBursts(line, &scratch);
+        if (n < 0) { cout << "Skipping streamed process " << line << " - every burst must be a whole number from 1 to " << INT32_MAX << endl; continue; }
+        if (n == 0) { continue; }  // Blank or comment line
+        if (n % 2 == 0) { cout << "Skipping streamed process " << line << " - it must start and end with a CPU burst" << endl; continue; }
+        int arrival = parseArrival(line);  // No arrival time arrives with the last process
+        if (arrival >= 0 && arrival < pendingArrival) { cout << "Skipping streamed process " << line << " - it arrives before the process above it, and processes must be in arrival order" << endl; continue; }  // Time can't go back (--convert rejects the same line)
+        if (arrival > pendingArrival) { pendingArrival = arrival; }
+        return true;
+    }
+    return false;  // End of the stream
+}
+
+PCB* ProcessStream::create() {  // Makes the next PCB, using the explicit value constructor with the process ID number, the array of CPU/IO bursts and the data array size
+    PCB* p = pcbs.take();
+    if (generating) {  // Generate the process now that it has arrived - its bursts are drawn as it reaches them
+        int count;
+        uint64_t random = generator.make(&count);
+        *p = PCB(next + 1, NULL, count);
+        p->generateBursts(random);
+        activeGenerator = &generator;
+    }
+    else if (streaming) { more();  *p = PCB(next + 1, arena.add(scratch), (int)scratch.size());  pending = false; }  // Bursts of the process read last
+    else { *p = PCB(next + 1, workload->bursts(next), workload->burstCount(next)); }  // Bursts are read in place from the workload
+    next++;
+    return p;
+}
+
+void ProcessStream::recycle(PCB* pcb) {
+    if (!reusing) { return; }
+    if (streaming) { arena.release(pcb->getData(), pcb->burstCount()); }
+    pcbs.give(pcb);
+}
+
+void ProcessStream::save(Snapshot* s) {
+    s->created = next;
+    if (generating) { generator.save(s); }
+}
+
+vector<PCB*> ProcessStream::restore(const Snapshot& s, PCB** waiting, PCB** terminated, vector<PCB*>* running) {  // Workload processes point into the workload again, and generated processes draw their random numbers again up to the burst they are on
+    next = s.created;
+    if (generating) { generator.restore(s); }
+    vector<PCB*> restored(s.processes.size(), NULL);
+    for (size_t i = 0; i < s.processes.size(); i++) {
+        const PCBRecord& r = s.processes[i];
+        if (r.place == PLACE_TERMINATED && reusing) { continue; }  // Already counted in the metrics
+        PCB* p = pcbs.take();
+        PCB** list = r.place == PLACE_WAITING ? waiting : r.place == PLACE_TERMINATED ? terminated : r.place == PLACE_RUNNING ? &(*running)[r.queue] : NULL;
+        p->restore(r, generating ? NULL : workload->bursts(r.processID - 1), list);
+        if (generating) { p->generateBursts(generator.randomAt(r.processID - 1, r.dataIndex));  activeGenerator = &generator; }
+        restored[i] = p;
+    }
+    return restored;
+}
+
+// Snapshots: //
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'C', 'H', 'E', 'D', 'S', 'N', '1' }; // Magic bytes at the start of every snapshot file
+const uint32_t SNAPSHOT_VERSION = 2;  // Version written by Snapshot::save (2 dropped the CPU and IO times from the process records)
+
+struct SnapshotHeader { // Header at the start of a snapshot file - followed by cpus int32 idle times, queueStates int64 queue states, processCount PCB records, burstCount int32 bursts, eventCount events, then the waiting, turnaround and response histograms and the number of dispatches, all little endian
+    char magic[8];      // SNAPSHOT_MAGIC
+    uint32_t version;   // SNAPSHOT_VERSION
+    int32_t time, cpus, migrations;
+    int64_t eventCount;
+    uint64_t seed;
+    int32_t workloadProcesses, created, generatorMade, generatorArrival;
+    uint64_t generatorRandom;
+    int32_t recycled, queueStates;
+    int64_t processCount, burstCount, eventRecords;
+    char scheduler[16];  // Name of the scheduler, NUL padded
+};
+
+bool Snapshot::save(string path) const {
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == NULL) { cout << "Could not create snapshot " << path << endl; return false; }
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.time = time;  header.cpus = cpus;  header.migrations = migrations;  header.eventCount = eventCount;  header.seed = seed;
+    header.workloadProcesses = workloadProcesses;  header.created = created;  header.generatorMade = generatorMade;  header.generatorArrival = generatorArrival;  header.generatorRandom = generatorRandom;
+    header.recycled = recycled;  header.queueStates = (int32_t)queueState.size();
+    header.processCount = processes.size();  header.burstCount = bursts.size();  header.eventRecords = events.size();
+    strncpy(header.scheduler, scheduler.c_str(), sizeof(header.scheduler) - 1);
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1
+        && fwrite(idleTime.data(), sizeof(int), idleTime.size(), out) == idleTime.size()
+        && fwrite(queueState.data(), sizeof(long long), queueState.size(), out) == queueState.size()
+        && fwrite(processes.data(), sizeof(PCBRecord), processes.size(), out) == processes.size()
+        && fwrite(bursts.data(), sizeof(int), bursts.size(), out) == bursts.size()
+        && fwrite(events.data(), sizeof(SnapshotEvent), events.size(), out) == events.size()
+        && metrics.waiting.write(out) && metrics.turnaround.write(out) && metrics.response.write(out)
+        && fwrite(&metrics.dispatches, sizeof(uint64_t), 1, out) == 1;
+    ok = fclose(out) == 0 && ok;
+    if (!ok) { cout << "Could not write snapshot " << path << endl; }
+    return ok;
+}
+
+bool Snapshot::load(string path) {  // Read with stdio rather than mapped, since every part is copied into its vector anyway
+    FILE* in = fopen(path.c_str(), "rb");
+    if (in == NULL) { cout << "Could not open snapshot " << path << endl; return false; }
+    SnapshotHeader header;
+    bool ok = fread(&header, sizeof(header), 1, in) == 1;
+    if (!ok || memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version != SNAPSHOT_VERSION || header.cpus < 1 || header.queueStates < 0 || header.processCount < 0 || header.burstCount < 0 || header.eventRecords < 0) {
+        cout << "Snapshot " << path << " is not a version " << SNAPSHOT_VERSION << " snapshot file" << endl;
+        fclose(in);
+        return false;
+    }
+    struct stat info;  // The header's counts must fit in the file, so a corrupt header can't ask for a huge allocation
+    uint64_t needed = sizeof(header) + (uint64_t)header.cpus * sizeof(int) + (uint64_t)header.queueStates * sizeof(long long) + (uint64_t)header.processCount * sizeof(PCBRecord) + (uint64_t)header.burstCount * sizeof(int) + (uint64_t)header.eventRecords * sizeof(SnapshotEvent);
+    if (fstat(fileno(in), &info) != 0 || needed > (uint64_t)info.st_size) { cout << "Snapshot " << path << " is cut short" << endl;  fclose(in);  return false; }
+    header.scheduler[sizeof(header.scheduler) - 1] = '\0';
+    scheduler = header.scheduler;
+    time = header.time;  cpus = header.cpus;  migrations = header.migrations;  eventCount = header.eventCount;  seed = header.seed;
+    workloadProcesses = header.workloadProcesses;  created = header.created;  generatorMade = header.generatorMade;  generatorArrival = header.generatorArrival;  generatorRandom = header.generatorRandom;
+    recycled = header.recycled != 0;
+    idleTime.resize(cpus);  queueState.resize(header.queueStates);  processes.resize(header.processCount);  bursts.resize(header.burstCount);  events.resize(header.eventRecords);
+    ok = fread(idleTime.data(), sizeof(int), idleTime.size(), in) == idleTime.size()
+        && fread(queueState.data(), sizeof(long long), queueState.size(), in) == queueState.size()
+        && fread(processes.data(), sizeof(PCBRecord), processes.size(), in) == processes.size()
+        && fread(bursts.data(), sizeof(int), bursts.size(), in) == bursts.size()
+        && fread(events.data(), sizeof(SnapshotEvent), events.size(), in) == events.size()
+        && metrics.waiting.read(in) && metrics.turnaround.read(in) && metrics.response.read(in)
+        && fread(&metrics.dispatches, sizeof(uint64_t), 1, in) == 1;
+    fclose(in);
+    if (!ok) { cout << "Snapshot " << path << " is cut short" << endl; return false; }
+    size_t burstTotal = 0;  // Every record's bursts must be in the file, and every event's process must be a record
+    vector<bool> busy(cpus, false);  // CPUs a running record is on
+    ok = workloadProcesses >= 0 && created >= 0 && created <= workloadProcesses && generatorMade >= 0 && generatorMade <= workloadProcesses && generatorArrival >= 0 && migrations >= 0 && eventCount >= 0;  // The workload can't have got further than its last process
+    for (size_t i = 0; i < processes.size() && ok; i++) {
+        const PCBRecord& r = processes[i];
+        bool queued = r.place == PLACE_READY || r.place == PLACE_RUNNING;  // queue is a ready queue or CPU
+        if (r.processID < 1 || r.processID > created || r.dataSize < 1 || r.dataIndex < -1 || r.dataIndex >= r.dataSize || r.state < NEW || r.state > TERMINATED || r.place > PLACE_TERMINATED || r.cpu < -1 || r.cpu >= cpus) { ok = false; }  // Only processes that have arrived are recorded - dataIndex and cpu are -1 until the process first runs
+        else if (queued && (r.queue < 0 || r.queue >= cpus)) { ok = false; }  // There are never more ready queues than CPUs
+        else if (r.place == PLACE_RUNNING) { ok = !busy[r.queue];  busy[r.queue] = true; }  // One process per CPU
+        burstTotal += r.dataSize;
+    }
+    for (size_t i = 0; i < events.size() && ok; i++) {
+        const SnapshotEvent& e = events[i];
+        if (e.type < ARRIVAL || e.type > BALANCE || e.pcb < -1 || e.pcb >= (int)processes.size()) { ok = false; }
+        else if (e.type == IO_COMPLETE && (e.pcb < 0 || processes[e.pcb].place != PLACE_WAITING || processes[e.pcb].cpu < 0)) { ok = false; }  // Its process goes back to the queue of its CPU
+    }
+    if (!ok || burstTotal != bursts.size()) { cout << "Snapshot " << path << " is not consistent" << endl; return false; }
+    return true;
+}
+
+// Scheduling policies: //
+
+// A policy is a small class that the simulation engine is compiled for, so every hook call in the event loop is a direct (usually inlined) call - no virtual functions and no string compares.
+// It declares the type of its ready queue and fills in these hooks (PolicyBase has the defaults):
+//   makeQueue      - an empty ready queue (one per CPU, or one shared)
+//   enqueue        - admits a newly arrived process to a ready queue
+//   pickNext       - the process a ready queue runs next (queue is not empty)
+//   onDispatch     - called once the picked process is running (and out of the queue), e.g. to schedule the end of its time quantum
+//   onTick         - called on the running process at every event, to move it on when its burst or quantum ends
+//   shouldPreempt  - true if a ready process should take over the CPU from the running one (sharing is every CPU's running process when the queue is shared by every CPU, NULL when it is this CPU's own)
+//   period/onPeriod - something done to every process every period time units (0 = never), like the MLFQ boost
+//   adopt          - fits a process restored from a snapshot to this policy (switched is true if the snapshot was taken under another scheduler)
+//   saveQueue/restoreQueue - policy state a ready queue keeps besides its processes, carried over in a snapshot
+//   onWakeup       - called once a process that finished its IO is back in a ready queue
+// Processes that finish their IO go back to a ready queue through PCB::waitManage, a template on the queue type like the other PCB transitions.
+
+struct PolicyBase { // Default hooks - a policy only writes the ones it changes
+    template <class Queue> void onDispatch(PCB* /*p*/, Queue* /*ready*/, int /*time*/, EventQueue* /*events*/) {}  // Nothing to set up
+    template <class Queue> void onWakeup(PCB* /*p*/, Queue* /*ready*/, int /*time*/) {}  // Nothing to note
+    template <class Queue> void onTick(PCB** running, Queue* /*ready*/, PCB** waiting, PCB** terminated, int time, EventQueue* events) { (*running)->cpuManage(running, waiting, terminated, time, events); }  // End of burst - go to waiting or terminated
+    template <class Queue> bool shouldPreempt(PCB* /*running*/, Queue* /*ready*/, int /*time*/, const vector<PCB*>* /*sharing*/) { return false; }  // Never preempts
+    template <class Queue> void printPreemption(PCB* /*p*/, Queue* /*ready*/, int /*time*/) {}
+    int period() { return 0; }  // Nothing periodic
+    template <class Queue> void onPeriod(vector<Queue>* /*queues*/, PCB** /*waiting*/, vector<PCB*>& /*running*/, int /*time*/, EventQueue* /*events*/) {}
+    void adopt(PCB* /*p*/, bool /*switched*/) {}  // Nothing to fit
+    template <class Queue> void saveQueue(Queue* /*ready*/, vector<long long>* /*state*/) {}  // No state besides the processes
+    template <class Queue> void restoreQueue(Queue* /*ready*/, const vector<long long>& /*state*/, int /*q*/, bool /*switched*/) {}
+};
+
+struct SJFPolicy : PolicyBase { // Shortest Job First - the ready process with the shortest next CPU burst runs, until its burst ends
+    typedef ReadyHeap Queue;
+    Queue makeQueue() { return ReadyHeap(); }
+    void enqueue(PCB* p, Queue* ready, int time) { p->admitProcess(ready, time); }
+    PCB* pickNext(Queue* ready) { return ready->top(); }
+};
+
+struct SRTFPolicy : SJFPolicy { // Shortest Remaining Time First - SJF, but a ready process that needs less time than the running one has left takes over
+    bool shouldPreempt(PCB* running, Queue* ready, int time, const vector<PCB*>* /*sharing*/) { return !ready->empty() && ready->topKey() < running->getBurstEnd() - time; }
+    void printPreemption(PCB* p, Queue* ready, int time) { cout << "\nPREEMPTION: time:" << time << " Currently running: P" << p->getID() << " [" << p->remainingBurst() << " left]  Preemption from: P" << ready->top()->getID() << " [" << ready->topKey() << "]" << "\n"; }
+};
+
+struct MLFQPolicy : PolicyBase { // Multilevel Feedback Queue - highest level first, a process that uses up its time quantum goes down a level, and a higher level process preempts a lower one
+    typedef MLFQQueues Queue;
+    MLFQConfig config;  // Levels, quanta and boost interval
+    MLFQPolicy(const MLFQConfig& iconfig) : config(iconfig) {}
+    Queue makeQueue() { return MLFQQueues(config.levels, config.quanta[0]); }
+    void enqueue(PCB* p, Queue* ready, int time) { p->setPriority(1, ready->getTopQuantum());  p->admitProcess(ready, time); }  // New processes start at priority 1 with the top level quantum
+    PCB* pickNext(Queue* ready) { return ready->first(); }
+    void onDispatch(PCB* p, Queue* /*ready*/, int time, EventQueue* events) {  // The time quantum starts running now - levels with a time quantum run out of it
+        p->startQuantum(time);
+        if (config.quanta[p->getPriority() - 1] > 0) { events->schedule(p->getQuantumEnd(), QUANTUM_EXPIRE, p); }
+    }
+    void onTick(PCB** running, Queue* ready, PCB** waiting, PCB** terminated, int time, EventQueue* events) { (*running)->cpuManageMLFQ(ready, running, waiting, terminated, time, events, config); }
+    bool shouldPreempt(PCB* running, Queue* ready, int /*time*/, const vector<PCB*>* /*sharing*/) { return !ready->empty() && ready->highestLevel() < running->getPriority() - 1; }  // A process in a higher level is ready
+    void printPreemption(PCB* p, Queue* ready, int time) { cout << "\nPREEMPTION: time:" << time << " Currently running: P" << p->getID() << " p" << p->getPriority() << "  Preemption from: P" << ready->first()->getID() << " p" << ready->first()->getPriority() << "\n"; }
+    int period() { return config.boostInterval; }
+    void adopt(PCB* p, bool switched) {  // A process from another scheduler starts at the top level, and one from an MLFQ with more levels goes to the lowest
+        int priority = switched ? 1 : min(p->getPriority(), config.levels);
+        p->setPriority(priority, config.quanta[priority - 1] > 0 ? config.quanta[priority - 1] : p->getQuantum());  // Levels with a quantum always give their processes it
+    }
+    void onPeriod(vector<Queue>* queues, PCB** waiting, vector<PCB*>& running, int time, EventQueue* events) {  // Priority boost: every ready, waiting and running process goes back to priority 1
+        for (size_t q = 0; q < queues->size(); q++) { (*queues)[q].boost(config.quanta[0]); }
+        for (PCB* p = *waiting; p != NULL; p = p->getpcbPointer()) { p->setPriority(1, config.quanta[0]); }
+        for (size_t c = 0; c < running.size(); c++) {
+            if (running[c] != NULL && running[c]->getPriority() != 1) {  // A running process starts a top level quantum now
+                running[c]->setPriority(1, config.quanta[0]);
+                running[c]->startQuantum(time);
+                if (config.quanta[0] > 0) { events->schedule(running[c]->getQuantumEnd(), QUANTUM_EXPIRE, running[c]); }
+            }
+        }
+    }
+};
+
+struct FCFSPolicy : MLFQPolicy { // First Come First Serve - a single level that runs each burst to the end
+    FCFSPolicy() : MLFQPolicy(makeMLFQConfig(1)) {}
+};
+
+struct RRPolicy : MLFQPolicy { // Round Robin - a single level with a time quantum, so a process that uses up its quantum goes to the back of the queue
+    RRPolicy(int quantum) : MLFQPolicy(makeMLFQConfig(1)) { config.quanta[0] = quantum; }
+};
+
+struct PriorityPolicy : PolicyBase { // Preemptive priority with aging - process Pn has priority (n - 1) mod levels + 1, the highest priority ready process runs, and waiting in the ready queue raises a process's priority by one every agingInterval time units until it runs
+    typedef ReadyHeap Queue;
+    int levels;         // Number of priorities (1 is the highest)
+    int agingInterval;  // Time between agings (0 = no aging)
+    PriorityPolicy(int ilevels, int iaging) { levels = ilevels; agingInterval = iaging; }
+    int basePriority(PCB* p) { return (p->getID() - 1) % levels + 1; }
+    Queue makeQueue() { return ReadyHeap(true); }  // Keyed on priority
+    void enqueue(PCB* p, Queue* ready, int time) { p->setPriority(basePriority(p), 0);  p->admitProcess(ready, time); }
+    PCB* pickNext(Queue* ready) { return ready->top(); }
+    void onDispatch(PCB* p, Queue* /*ready*/, int /*time*/, EventQueue* /*events*/) { p->setPriority(basePriority(p), 0); }  // Aging only lasts until the process runs
+    bool shouldPreempt(PCB* running, Queue* ready, int /*time*/, const vector<PCB*>* /*sharing*/) { return !ready->empty() && ready->topKey() < running->getPriority(); }  // A higher priority process is ready
+    void printPreemption(PCB* p, Queue* ready, int time) { cout << "\nPREEMPTION: time:" << time << " Currently running: P" << p->getID() << " p" << p->getPriority() << "  Preemption from: P" << ready->top()->getID() << " p" << ready->topKey() << "\n"; }
+    int period() { return agingInterval; }
+    void adopt(PCB* p, bool switched) { if (switched || p->getPriority() > levels) { p->setPriority(basePriority(p), 0); } }  // Aging under another scheduler doesn't carry over
+    void onPeriod(vector<Queue>* queues, PCB** /*waiting*/, vector<PCB*>& /*running*/, int /*time*/, EventQueue* /*events*/) {  // Aging: every ready process goes up one priority
+        for (size_t q = 0; q < queues->size(); q++) {
+            Queue& heap = (*queues)[q];
+            vector<PCB*> ready;  // decreaseKey can move an unaged process into a slot already passed, so go through a copy - each is aged once, whatever order the heap is in
+            for (int i = 0; i < heap.size(); i++) { ready.push_back(heap.at(i)); }
+            for (size_t i = 0; i < ready.size(); i++) {
+                PCB* p = ready[i];
+                if (p->getPriority() > 1) { p->setPriority(p->getPriority() - 1, 0);  heap.decreaseKey(p, p->getPriority()); }
+            }
+        }
+    }
+};
+
+struct CFSPolicy : PolicyBase { // Completely Fair Scheduler style fair share - the ready process with the lowest vruntime (CPU time so far, divided by its nice weight) runs for its weight's share of the scheduling period, and a woken process well behind the running one preempts it
+    typedef VruntimeTree Queue;
+    vector<int> weights;    // Process Pn has weight weights[(n - 1) mod size]
+    int latency;            // Scheduling period every ready process should run within (0 = every slice is granularity long, for stride scheduling)
+    int granularity;        // Shortest slice, and how far the running process must be ahead in vruntime (in nice 0 time units) for a woken process to preempt it
+    long long sleeperCredit;  // How far behind the minimum vruntime a woken process is placed at most - half the period, like the kernel
+    bool wakeupPreemption;    // False to only switch at the end of a slice
+    CFSPolicy(const vector<int>& iweights, int ilatency, int igranularity) { weights = iweights;  latency = ilatency;  granularity = igranularity;  sleeperCredit = ilatency / 2 * VRUNTIME_UNIT;  wakeupPreemption = true; }
+    Queue makeQueue() { return VruntimeTree(sleeperCredit); }
+    void enqueue(PCB* p, Queue* ready, int time) { p->setWeight(weights[(p->getID() - 1) % weights.size()]);  p->setVruntime(ready->minVruntime());  p->admitProcess(ready, time);  ready->wake(p); }  // New processes start level with the queue, and an arrival can preempt the running process
+    PCB* pickNext(Queue* ready) { return ready->first(); }
+    int slice(PCB* p, Queue* ready) {  // Time the process runs before the next process gets a turn
+        if (latency == 0) { return granularity; }
+        long long period = max((long long)latency, (long long)(ready->size() + 1) * granularity);  // The period stretches when there are too many processes to give each the shortest slice
+        return (int)max((long long)granularity, period * p->getWeight() / (ready->totalWeight() + p->getWeight()));
+    }
+    void onDispatch(PCB* p, Queue* ready, int time, EventQueue* events) {
+        ready->advance(p->getVruntime(time));
+        ready->takeWoken();  // A wakeup is only compared with the processes running when it happens - once a CPU picks again, it is over
+        p->startQuantum(time, slice(p, ready));
+        events->schedule(p->getQuantumEnd(), QUANTUM_EXPIRE, p);
+    }
+    void onWakeup(PCB* p, Queue* ready, int /*time*/) { ready->wake(p); }  // A woken process may be moved up to the tree's minimum (in push), and may preempt the running process
+    void onTick(PCB** running, Queue* ready, PCB** waiting, PCB** terminated, int time, EventQueue* events) {
+        PCB* p = *running;
+        ready->advance(p->getVruntime(time));
+        if (time >= p->getBurstEnd()) { p->cpuManage(running, waiting, terminated, time, events); }  // End of burst - go to waiting or terminated
+        else if (time >= p->getQuantumEnd()) {  // End of slice - give way to a process further behind, or else carry on with a new slice
+            if (!ready->empty() && ready->firstKey() < p->getVruntime(time)) { p->readyProcess(running, ready, time, TRACE_QUANTUM_EXPIRED); }
+            else { onDispatch(p, ready, time, events); }
+        }
+    }
+    bool shouldPreempt(PCB* running, Queue* ready, int time, const vector<PCB*>* sharing) {  // Only processes that just woke up or arrived are compared, so the rest wait for the end of the slice - and only with the running process furthest ahead in vruntime, if every CPU sharing the queue is busy (an idle one runs the woken process instead)
+        if (!wakeupPreemption || ready->getWoken() == INT64_MAX) { return false; }
+        for (size_t c = 0; sharing != NULL && c < sharing->size(); c++) {
+            PCB* other = (*sharing)[c];
+            if (other == NULL || (other != running && other->getVruntime(time) > running->getVruntime(time))) { return false; }  // Idle, or further ahead - it gets the wakeup
+        }
+        long long woken = ready->takeWoken();
+        return woken + granularity * VRUNTIME_UNIT < running->getVruntime(time);
+    }
+    void adopt(PCB* p, bool switched) { if (switched) { p->setWeight(weights[(p->getID() - 1) % weights.size()]); } }  // The vruntime carries over - every scheduler adds to it
+    void saveQueue(Queue* ready, vector<long long>* state) { state->push_back(ready->minVruntime());  state->push_back(ready->getWoken()); }
+    void restoreQueue(Queue* ready, const vector<long long>& state, int q, bool switched) {  // Called once the processes are pushed, so pushing them back doesn't move any up to the minimum
+        if (!switched && (int)state.size() >= 2 * q + 2) { ready->setMinVruntime(state[2 * q]);  ready->setWoken(state[2 * q + 1]); }
+        else { if (!ready->empty()) { ready->setMinVruntime(ready->firstKey()); }  ready->setWoken(INT64_MAX); }  // Start level with the lowest, with no wakeup to preempt for
+    }
+    void printPreemption(PCB* p, Queue* ready, int time) { cout << "\nPREEMPTION: time:" << time << " Currently running: P" << p->getID() << " [vruntime " << (double)p->getVruntime(time) / VRUNTIME_UNIT << "]  Preemption from: P" << ready->first()->getID() << " [vruntime " << (double)ready->firstKey() / VRUNTIME_UNIT << "]" << "\n"; }
+};
+
+struct StridePolicy : CFSPolicy { // Stride scheduling - proportional share like lottery scheduling but without the randomness: the process with the lowest pass (CPU time so far divided by its tickets) runs for one quantum
+    StridePolicy(const vector<int>& tickets, int quantum) : CFSPolicy(tickets, 0, quantum) { sleeperCredit = 0;  wakeupPreemption = false; }  // A process that wakes up starts no further behind than the lowest pass
+};
+
+vector<int> niceWeights(const vector<int>& nices) { // Weights of a list of nice values
+    vector<int> weights;
+    for (size_t i = 0; i < nices.size(); i++) { weights.push_back(niceWeight(nices[i])); }
+    return weights;
+}
+
+// Simulation engine: //
+
+template <class Policy>  // Policy is one of the policy classes above - the engine is compiled once for each
+void simulate(Policy& policy, string name, ProcessStream* arrivals, PCB** waiting, PCB** terminated, const SMPConfig& smp, OutputLevel output, SimulationResult* result, const Snapshot* from, int snapshotAt, Snapshot* snapshot) { // SCHEDULER - any policy on smp.cpus CPUs, each with its own running process, and one ready queue per CPU (or one shared queue for BALANCE_GLOBAL and for a single CPU) - starting at t=0, or from a snapshot, and running to the end, or until time snapshotAt is reached if there is a snapshot to fill in
+    typedef typename Policy::Queue Queue;
+    int cpus = smp.cpus;
+    bool global = cpus == 1 || smp.balance == BALANCE_GLOBAL;  // One queue shared by every CPU
+    vector<Queue> queues(global ? 1 : cpus, policy.makeQueue());
+    vector<PCB*> running(cpus, NULL);  // Process running on each CPU
+    vector<int> idleTime(cpus, 0);    // Time each CPU has spent with nothing running
+    int migrations = 0;              // Number of times a process ran on a different CPU to the last time
+    EventQueue events; // Pending arrivals, I/O completions, CPU burst completions, quantum expiries, periodic policy work and balancing, in time order
+    int period = policy.period();  // Time between the policy's periodic work (0 = none)
+    int nextPeriod = period;      // Time of the next periodic work
+    int t = 0;        // Current simulated time
+    if (snapshot != NULL) { output = OUTPUT_NONE; }  // A warm-up prints nothing - the simulations carrying on from it print the steps after
+    if (from == NULL) {  // Start at t=0 (otherwise the snapshot has the pending events, scheduled below)
+        if (period > 0) { events.schedule(nextPeriod, PRIORITY_BOOST, NULL); }
+        if (smp.balance == BALANCE_PUSH && !global) { events.schedule(smp.balanceInterval, BALANCE, NULL); }
+        if (arrivals->more()) { events.schedule(arrivals->nextArrival(), ARRIVAL, NULL); } // Wake up for the first arrival
+    }
+
+    auto queueOf = [&](int cpu) { return &queues[global ? 0 : cpu]; };  // Ready queue a CPU takes its processes from
+    auto load = [&](int cpu) { return queues[cpu].size() + (running[cpu] != NULL ? 1 : 0); };  // Processes a CPU has to run (per-CPU queues only)
+    auto leastLoaded = [&]() { int best = 0; for (int c = 1; c < cpus; c++) { if (load(c) < load(best)) { best = c; } } return best; };  // CPU a new process is admitted to
+    auto busiest = [&]() { int best = 0; for (int c = 1; c < cpus; c++) { if (queues[c].size() > queues[best].size()) { best = c; } } return best; };  // CPU with the most ready processes
+    auto migrate = [&](int from, int to) { PCB* p = policy.pickNext(&queues[from]); queues[from].remove(p); queues[to].push(p); };  // Moves the process a CPU would run next to another CPU's queue
+
+    if (from != NULL) {  // Carry on from a snapshot - rebuild the lists and queues in their saved order, then the pending events, so the same policy carries on exactly as if it had never stopped
+        bool switched = from->scheduler != name;  // Processes from another scheduler are fitted to this one
+        t = from->time;  migrations = from->migrations;  idleTime = from->idleTime;
+        result->metrics = from->metrics;  // Processes that terminated before the snapshot (activeMetrics points here)
+        vector<PCB*> pcbs = arrivals->restore(*from, waiting, terminated, &running);
+        for (size_t i = 0; i < pcbs.size(); i++) {
+            if (pcbs[i] == NULL) { continue; }  // Recycled
+            policy.adopt(pcbs[i], switched);
+            COUNT(inState[from->processes[i].state]++);
+            if (from->processes[i].place == PLACE_READY) { queueOf(from->processes[i].queue)->push(pcbs[i]); }
+        }
+        for (size_t q = 0; q < queues.size(); q++) { policy.restoreQueue(&queues[q], from->queueState, (int)q, switched); }
+        bool balancing = false;  // True once a balance event is scheduled
+        for (size_t i = 0; i < from->events.size(); i++) {
+            const SnapshotEvent& e = from->events[i];
+            if (e.type == BALANCE && (smp.balance != BALANCE_PUSH || global)) { continue; }  // Only push migration balances
+            events.schedule(e.time, (EventType)e.type, e.pcb >= 0 ? pcbs[e.pcb] : NULL);
+            if (e.type == BALANCE) { balancing = true; }
+        }
+        if (smp.balance == BALANCE_PUSH && !global && !balancing) { events.schedule(t + smp.balanceInterval, BALANCE, NULL); }
+        if (period > 0) { nextPeriod = max(period, (t + period - 1) / period * period);  events.schedule(nextPeriod, PRIORITY_BOOST, NULL); }  // The periodic work carries on from the clock, at the next multiple of this policy's period
+        if (switched) { for (int c = 0; c < cpus; c++) { if (running[c] != NULL) { policy.onDispatch(running[c], queueOf(c), t, &events); } } }  // Running processes start a quantum or slice of this policy
+        events.setCount(max(from->eventCount, events.count()));
+        if (output != OUTPUT_NONE) { cout << "\n[" << name << "] Continuing from time " << t << " (" << from->scheduler << " until then)" << "\n"; }
+    }
+    COUNT(begin(cpus, t));
+
+    while (true) {   // EVENT loop - each pass handles one point in time t, then jumps to the next event
+        if (snapshot != NULL && t >= snapshotAt) {  // Save everything and stop, for other simulations to carry on from
+            snapshot->scheduler = name;  snapshot->time = t;  snapshot->cpus = cpus;  snapshot->migrations = migrations;  snapshot->idleTime = idleTime;
+            snapshot->recycled = arrivals->recycling();
+            unordered_map<PCB*, int> index;  // Record of each process, for its events
+            auto record = [&](PCB* p, SnapshotPlace place, int queue) {
+                index[p] = (int)snapshot->processes.size();
+                PCBRecord r;
+                p->save(&r);  r.place = place;  r.queue = queue;
+                snapshot->processes.push_back(r);
+                p->copyBursts(&snapshot->bursts);
+            };
+            for (PCB* p = *waiting; p != NULL; p = p->getpcbPointer()) { record(p, PLACE_WAITING, 0); }
+            for (PCB* p = *terminated; p != NULL; p = p->getpcbPointer()) { record(p, PLACE_TERMINATED, 0); }
+            for (size_t q = 0; q < queues.size(); q++) {
+                vector<PCB*> ready;
+                queues[q].collect(&ready);
+                for (size_t i = 0; i < ready.size(); i++) { record(ready[i], PLACE_READY, (int)q); }
+                policy.saveQueue(&queues[q], &snapshot->queueState);
+            }
+            for (int c = 0; c < cpus; c++) { if (running[c] != NULL) { record(running[c], PLACE_RUNNING, c); } }
+            vector<Event> pending = events.pending();
+            for (size_t i = 0; i < pending.size(); i++) {
+                if (pending[i].type == PRIORITY_BOOST) { continue; }  // Periodic work is rescheduled by the policy that carries on
+                unordered_map<PCB*, int>::iterator found = index.find(pending[i].pcb);
+                SnapshotEvent e = { pending[i].time, pending[i].type, found == index.end() ? -1 : found->second };
+                snapshot->events.push_back(e);
+            }
+            snapshot->eventCount = events.count();
+            arrivals->save(snapshot);
+            snapshot->metrics = result->metrics;
+            return;
+        }
+        if (period > 0 && t >= nextPeriod) {  // If it is time for the policy's periodic work (MLFQ priority boost, priority aging)
+            policy.onPeriod(&queues, waiting, running, t, &events);
+            COUNT(periodic++);
+            nextPeriod += period;  // Schedule the next one
+            events.schedule(nextPeriod, PRIORITY_BOOST, NULL);
+        }
+        while (!events.empty() && events.nextTime() <= t) {  // Handle every event due at time t, in order
+            Event e = events.pop();
+            if (e.type == IO_COMPLETE) {  // Back to the queue of the CPU it last ran on, whose caches it is warm in
+                if (e.pcb->waitManage(waiting, queueOf(e.pcb->getCPU()), t)) { policy.onWakeup(e.pcb, queueOf(e.pcb->getCPU()), t); }
+            }
+            else if (e.type == ARRIVAL) {  // Admit each process that has arrived to the CPU with the least to do
+                while (arrivals->more() && arrivals->nextArrival() <= t) { policy.enqueue(arrivals->create(), queueOf(global ? 0 : leastLoaded()), t); }
+                if (arrivals->more()) { events.schedule(arrivals->nextArrival(), ARRIVAL, NULL); }
+            }
+            else if (e.type == BALANCE) {  // Push migration: even out the loads until no CPU has more than one process more than another
+                while (true) {
+                    int from = 0, to = 0;
+                    for (int c = 1; c < cpus; c++) { if (load(c) > load(from)) { from = c; } if (load(c) < load(to)) { to = c; } }
+                    if (load(from) - load(to) <= 1 || queues[from].empty()) { break; }
+                    migrate(from, to);
+                }
+                events.schedule(t + smp.balanceInterval, BALANCE, NULL);
+            }
+        }  // CPU burst and quantum events only wake the scheduler up - onTick checks each running process itself
+
+        bool dispatched = false;  // True if any CPU started a process at time t
+        for (int pass = 0; pass < 2; pass++) {  // First every CPU runs from its own queue, then (BALANCE_STEAL) CPUs left idle steal
+            for (int c = 0; c < cpus; c++) {
+                if (pass == 0 && running[c] != NULL) {  // End of burst or quantum, or preemption
+                    policy.onTick(&running[c], queueOf(c), waiting, terminated, t, &events);
+                    if (running[c] != NULL && policy.shouldPreempt(running[c], queueOf(c), t, global ? &running : NULL)) {
+                        PCB* p = running[c];  // Keep the preempted process to print it
+                        p->readyProcess(&running[c], queueOf(c), t, TRACE_PREEMPTED);  // Back to this CPU's queue - the process that should run is picked below
+                        if (output == OUTPUT_STEPS) { policy.printPreemption(p, queueOf(c), t); }
+                    }
+                }
+                if (running[c] != NULL) { continue; }  // Busy
+                if (pass == 1) {  // Steal the process the busiest CPU would run next
+                    if (smp.balance != BALANCE_STEAL || global || !queueOf(c)->empty()) { continue; }
+                    int victim = busiest();
+                    if (queues[victim].empty()) { continue; }  // Nothing to steal anywhere
+                    migrate(victim, c);
+                }
+                if (queueOf(c)->empty()) { continue; }  // Nothing to run
+                COUNT(startDecision());
+                PCB* p = policy.pickNext(queueOf(c));
+                if (p->remainingBurst() <= 0) { p->incrementPC(); }  // If the burst is up, increment program counter (a preempted process continues its burst)
+                if (p->moveToCPU(c, smp.migrationCost)) { migrations++; }  // Moving CPU costs a cache warm up
+                p->runProcess(queueOf(c), &running[c], t);  // Run it
+                events.schedule(p->getBurstEnd(), BURST_COMPLETE, p);  // Schedule the end of the (rest of the) CPU burst
+                policy.onDispatch(p, queueOf(c), t, &events);
+                COUNT(dispatched(c, p->getID()));
+                dispatched = true;
+            }
+        }
+        if (arrivals->recycling()) {  // Terminated processes have been counted in the metrics, so their PCBs can go back to the pool
+            while (*terminated != NULL) { PCB* p = *terminated;  *terminated = p->getpcbPointer();  arrivals->recycle(p); }
+        }
+        if (dispatched && output == OUTPUT_STEPS) {  // Print the step, unless running quietly
+            if (cpus == 1) { cout << "\n[" << name << "] Current Execution time: " << t << "\n"; }  // Print scheduler type and the current exec time
+            else { cout << "\n[" << name << " x" << cpus << "] Current Execution time: " << t << "\n"; }  // and the number of CPUs, if more than one
+            for (int c = 0; c < cpus; c++) {  // What each CPU is running
+                if (cpus > 1) { cout << "CPU " << c << ": "; }
+                if (running[c] != NULL) { running[c]->printStatus(t); } else { cout << "idle" << "\n"; }
+            }
+            for (size_t q = 0; q < queues.size(); q++) { if (!queues[q].empty()) { cout << "Ready"; if (!global) { cout << " (CPU " << q << ")"; } cout << ":" << "\n"; queues[q].printStatus(t); } }  // Every non-empty ready queue
+            if (*waiting != NULL) { cout << "Waiting:" << "\n"; (*waiting)->printStatus(t); } // If something in waiting list, call recursive print status on list head to print the whole list
+            if (*terminated != NULL) { cout << "Terminated:" << "\n"; (*terminated)->printStatus(t); } // If something in terminated list, call recursive print status on list head to print the whole list
+        }
+
+        bool finished = *waiting == NULL && !arrivals->more();  // All processes done once nothing is waiting, ready, running or still to arrive
+        for (size_t q = 0; q < queues.size(); q++) { if (!queues[q].empty()) { finished = false; } }
+        for (int c = 0; c < cpus; c++) { if (running[c] != NULL) { finished = false; } }
+        if (finished) {  // Print final table and end loop
+            if (arrivals->created() > 0) {
+                int idle = 0;
+                for (int c = 0; c < cpus; c++) { idle += idleTime[c]; }
+                result->totalTime = t;  result->idleTime = idle;  result->cpus = cpus;  result->migrations = migrations;  result->events = events.count();  // Save the results (the process times were counted as they terminated)
+                if (output != OUTPUT_NONE) {  // Print the results, unless sweeping
+                    if (cpus == 1) { cout << "\n" << name << " Results:\nTotal time: " << t << "  CPU Utilization: " << (1 - (float)idle / t) * 100 << "%" << endl; }  // Print the scheduler type, total time taken, and CPU utilization
+                    else {
+                        cout << "\n" << name << " Results (" << cpus << " CPUs, " << (global ? "global queue" : smp.balance == BALANCE_PUSH ? "push migration" : "work stealing") << "):\nTotal time: " << t << "  CPU Utilization: " << (1 - (float)idle / ((float)t * cpus)) * 100 << "%  Migrations: " << migrations << endl;
+                        for (int c = 0; c < cpus; c++) { cout << "CPU " << c << " Utilization: " << (1 - (float)idleTime[c] / t) * 100 << "%" << endl; }  // Utilization of each CPU
+                    }
+                    if (*terminated != NULL) { (*terminated)->printTable(*result); }  // Then print all of the processes in table (in terminated list)
+                    else { printMetrics(*result); }  // or just the averages, percentiles and throughput if the PCBs were recycled
+                }
+            }
+            return;
+        }
+        else if (events.empty()) { cout << "\n" << name << " stopped at time " << t << " - no pending events" << endl; return; } // Nothing left that could change the lists (should not happen)
+        int units = events.nextTime() - t;  // Number of time units until the next event
+        for (int c = 0; c < cpus; c++) { if (running[c] == NULL) { idleTime[c] += units; } }  // Each CPU with nothing running was idle for the skipped time
+        COUNT(elapse(t, units));
+        t += units; // Jump straight to the next event
+    }
+}
+
+
+SimulationResult runSimulation(string scheduler, const MLFQConfig& mlfq, const PolicyConfig& policies, const SMPConfig& smp, Workload& workload, const GeneratorConfig& generator, OutputLevel output, const Snapshot* from, int snapshotAt, Snapshot* snapshot) { // Function to call a scheduler simulation, using fresh list pointers and PCBs each time called (mlfq holds the MLFQ levels, quanta and boost interval, policies the settings of the other schedulers, smp the number of CPUs and how they share processes, workload the burst data unless generator says to generate processes, output how much to print, from a snapshot to carry on from and snapshot one to take at time snapshotAt)
+    // Create the states of OS
+    PCB* waitingList = nullptr; // PCB waiting list
+    PCB* terminatedList = nullptr; // terminated processes
+    SimulationResult result = SimulationResult();  // Everything zero (and the counters, when counting)
+    result.totalTime = -1;  // Stays unfinished unless the scheduler completes
+    result.cpus = 1;
+
+    uint64_t seed = generator.processes > 0 ? generator.seed : 0;  // Which workload this is, to check a snapshot against
+    int processes = generator.processes > 0 ? generator.processes : workload.processCount();
+    if (from != NULL && from->time < 0) { from = NULL; }  // Every process finished before the snapshot would have been taken, so start from t=0
+    if ((from != NULL || snapshot != NULL) && workload.streaming()) { cout << "A stream can not be snapshotted" << endl; return result; }  // Its processes can't be read again
+    if (from != NULL && (from->seed != seed || from->workloadProcesses != processes || from->cpus != smp.cpus)) { cout << "The snapshot is of another workload or number of CPUs" << endl; return result; }
+    for (size_t i = 0; from != NULL && generator.processes == 0 && i < from->processes.size(); i++) {  // Workload processes read their bursts from the workload again, so each must have as many as it had
+        if (from->processes[i].dataSize != workload.burstCount(from->processes[i].processID - 1)) { cout << "The snapshot is of another workload or number of CPUs" << endl; return result; }
+    }
+    if (from != NULL && generator.processes > 0) {  // Generated processes draw their bursts again, so the generator settings must give the same ones
+        WorkloadGenerator check(generator);
+        vector<int> bursts;
+        for (size_t i = 0; i < from->processes.size(); i++) { check.bursts(from->processes[i].processID - 1, &bursts); }
+        if (bursts != from->bursts) { cout << "The snapshot is of another workload or number of CPUs" << endl; return result; }
+    }
+    if (snapshot != NULL) { snapshot->seed = seed;  snapshot->workloadProcesses = processes; }
+    bool recycle = output == OUTPUT_NONE || workload.streaming() || (from != NULL && from->recycled);  // Keep every PCB only if the results table lists them (and the snapshot kept them too) - otherwise memory is bounded by the processes alive at once
+    ProcessStream arrivals = generator.processes > 0 ? ProcessStream(generator, recycle) : ProcessStream(&workload, recycle);  // The PCB of each process is created when it arrives - workload bursts are only read, so simulations running at the same time can share them
+    if (activeTrace != NULL) { activeTrace->begin(scheduler, smp.cpus); }  // Start this simulation's records in the trace
+    activeMetrics = &result.metrics;  // Count each process's times as it terminates
+#if SCHED_COUNTERS
+    if (counting) { activeCounters = &result.counters; }  // and the instrumentation counters, if asked for
+#endif
+    // Run the scheduler passed in the scheduler string input, with the list pointer addresses passed in - the engine is compiled for each policy, so this is the only place the name is compared:
+    if (scheduler == "SJF") { SJFPolicy policy;  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "SRTF") { SRTFPolicy policy;  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "FCFS") { FCFSPolicy policy;  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "MLFQ") { MLFQPolicy policy(mlfq);  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "RR") { RRPolicy policy(policies.rrQuantum);  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "PRIO") { PriorityPolicy policy(policies.priorityLevels, policies.agingInterval);  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "CFS") { CFSPolicy policy(niceWeights(policies.nice), policies.cfsLatency, policies.cfsGranularity);  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else if (scheduler == "STRIDE") { StridePolicy policy(policies.tickets, policies.rrQuantum);  simulate(policy, scheduler, &arrivals, &waitingList, &terminatedList, smp, output, &result, from, snapshotAt, snapshot); }
+    else { cout << "\nInvalid scheduling type! (check main)\nValid types are:\nSJF\nSRTF\nFCFS\nMLFQ\nRR\nPRIO\nCFS\nSTRIDE\n"; }
+    if (activeTrace != NULL) { activeTrace->end(result.totalTime); }
+    activeMetrics = NULL;
+#if SCHED_COUNTERS
+    activeCounters = NULL;
+#endif
+ 
+    return result;
+}
+
+
+void printSummary(string scheduler, const SimulationResult& r, string format, bool first) { // Prints the results of a simulation as one JSON object or CSV row (first is true for the first simulation, which starts the JSON list or prints the CSV header)
+    const Histogram* times[] = { &r.metrics.waiting, &r.metrics.turnaround, &r.metrics.response };
+    const char* names[] = { "waiting", "turnaround", "response" };
+    double utilization = r.totalTime > 0 ? 1 - (double)r.idleTime / ((double)r.totalTime * r.cpus) : 0;
+    double throughput = r.totalTime > 0 ? (double)r.metrics.turnaround.count() / r.totalTime : 0;
+    if (format == "csv") {
+        if (first) {
+            cout << "scheduler,cpus,processes,total_time,utilization,throughput,migrations";
+            for (int i = 0; i < 3; i++) { cout << "," << names[i] << "_mean," << names[i] << "_p50," << names[i] << "_p90," << names[i] << "_p99," << names[i] << "_p99_9," << names[i] << "_max"; }
+            cout << "\n";
+        }
+        cout << scheduler << "," << r.cpus << "," << r.metrics.turnaround.count() << "," << r.totalTime << "," << utilization << "," << throughput << "," << r.migrations;
+        for (int i = 0; i < 3; i++) { cout << "," << times[i]->mean() << "," << times[i]->percentile(50) << "," << times[i]->percentile(90) << "," << times[i]->percentile(99) << "," << times[i]->percentile(99.9) << "," << times[i]->max(); }
+        cout << endl;
+    }
+    else {  // JSON - the simulations make one list, closed by main
+        cout << (first ? "[\n" : ",\n") << "{\"scheduler\":\"" << scheduler << "\",\"cpus\":" << r.cpus << ",\"processes\":" << r.metrics.turnaround.count() << ",\"total_time\":" << r.totalTime
+             << ",\"utilization\":" << utilization << ",\"throughput\":" << throughput << ",\"migrations\":" << r.migrations;
+        for (int i = 0; i < 3; i++) { cout << ",\"" << names[i] << "\":{\"mean\":" << times[i]->mean() << ",\"p50\":" << times[i]->percentile(50) << ",\"p90\":" << times[i]->percentile(90) << ",\"p99\":" << times[i]->percentile(99) << ",\"p99.9\":" << times[i]->percentile(99.9) << ",\"max\":" << times[i]->max() << "}"; }
+        cout << "}";
+    }
+}
+
+#if SCHED_COUNTERS
+typedef vector<pair<string, string> > CounterLabels;  // Name and value of each label that tells the simulations apart in a counters file
+
+bool writeCounters(string path, string format, const vector<CounterLabels>& labels, const vector<SimulationResult>& results) { // Writes the counters of each simulation as Prometheus text exposition or JSON ("-" = stdout), returning false (with a message) if it can't
+    ofstream file;
+    if (path != "-") {
+        file.open(path.c_str());
+        if (!file) { cout << "Could not create counters file " << path << endl; return false; }
+    }
+    ostream& out = path == "-" ? cout : file;
+    const char* reasons[] = { "arrived", "dispatched", "io_started", "io_done", "preempted", "quantum_expired", "finished" };  // TraceReason names
+    const char* quantiles[] = { "0.5", "0.9", "0.99", "0.999" };
+    const double percents[] = { 50, 90, 99, 99.9 };
+    if (format == "json") {  // One object per simulation, with the queue length series
+        out << "[";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Counters& c = results[i].counters;
+            out << (i > 0 ? ",\n" : "\n") << "{\"labels\":{";
+            for (size_t l = 0; l < labels[i].size(); l++) { out << (l > 0 ? "," : "") << "\"" << labels[i][l].first << "\":\"" << labels[i][l].second << "\""; }
+            out << "},\"transitions\":{";
+            for (int r = 0; r < TRACE_END; r++) { out << (r > 0 ? "," : "") << "\"" << reasons[r] << "\":" << c.transitions[r]; }
+            out << "},\"context_switches\":" << c.contextSwitches << ",\"mlfq_demotions\":" << c.demotions << ",\"periodic\":" << c.periodic << ",\"migrations\":" << results[i].migrations << ",\"idle_time\":" << results[i].idleTime;
+            const Histogram* histograms[] = { &c.readyLength, &c.ioDepth, &c.decisionCycles };
+            const char* names[] = { "ready_length", "io_depth", "decision_ticks" };
+            for (int h = 0; h < 3; h++) {
+                out << ",\"" << names[h] << "\":{\"mean\":" << histograms[h]->mean();
+                for (int q = 0; q < 4; q++) { out << ",\"p" << percents[q] << "\":" << histograms[h]->percentile(percents[q]); }
+                out << ",\"max\":" << histograms[h]->max() << "}";
+            }
+            out << ",\"series\":{\"interval\":" << c.seriesInterval << ",\"time\":[";
+            for (size_t k = 0; k < c.series.size(); k++) { out << (k > 0 ? "," : "") << c.series[k].time; }
+            out << "],\"ready\":[";
+            for (size_t k = 0; k < c.series.size(); k++) { out << (k > 0 ? "," : "") << c.series[k].ready; }
+            out << "],\"io\":[";
+            for (size_t k = 0; k < c.series.size(); k++) { out << (k > 0 ? "," : "") << c.series[k].waiting; }
+            out << "]}}";
+        }
+        out << "\n]" << endl;
+    }
+    else {  // Prometheus text - every sample of a metric family comes after its HELP and TYPE lines, so each family goes through every simulation
+        auto labelText = [&](size_t i, string extra) {  // {name="value",...} of simulation i, with an extra label if given
+            string text;
+            for (size_t l = 0; l < labels[i].size(); l++) { text += (l > 0 ? "," : "") + labels[i][l].first + "=\"" + labels[i][l].second + "\""; }
+            if (extra != "") { text += (text != "" ? "," : "") + extra; }
+            return "{" + text + "}";
+        };
+        auto family = [&](string name, string type, string help) { out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n"; };
+        auto scalar = [&](string name, string type, string help, auto value) {  // One value per simulation
+            family(name, type, help);
+            for (size_t i = 0; i < results.size(); i++) { out << name << labelText(i, "") << " " << value(results[i]) << "\n"; }
+        };
+        auto summary = [&](string name, string help, auto histogram) {  // Quantiles, sum and count of a histogram per simulation
+            family(name, "summary", help);
+            for (size_t i = 0; i < results.size(); i++) {
+                const Histogram& h = histogram(results[i].counters);
+                for (int q = 0; q < 4; q++) { out << name << labelText(i, string("quantile=\"") + quantiles[q] + "\"") << " " << h.percentile(percents[q]) << "\n"; }
+                out << name << "_sum" << labelText(i, "") << " " << h.valueSum() << "\n" << name << "_count" << labelText(i, "") << " " << h.count() << "\n";
+            }
+        };
+        family("sched_transitions_total", "counter", "Process state changes by reason (preempted and quantum_expired are the preemptions, by cause)");
+        for (size_t i = 0; i < results.size(); i++) {
+            for (int r = 0; r < TRACE_END; r++) { out << "sched_transitions_total" << labelText(i, string("reason=\"") + reasons[r] + "\"") << " " << results[i].counters.transitions[r] << "\n"; }
+        }
+        scalar("sched_context_switches_total", "counter", "Dispatches of a different process to the one the CPU ran last", [](const SimulationResult& r) { return r.counters.contextSwitches; });
+        scalar("sched_mlfq_demotions_total", "counter", "MLFQ processes moved down a level for using up their quantum", [](const SimulationResult& r) { return r.counters.demotions; });
+        scalar("sched_periodic_total", "counter", "Runs of the policy's periodic work (MLFQ priority boosts, priority aging)", [](const SimulationResult& r) { return r.counters.periodic; });
+        scalar("sched_migrations_total", "counter", "Dispatches on a different CPU to the one the process last ran on", [](const SimulationResult& r) { return r.migrations; });
+        scalar("sched_idle_time", "gauge", "Time units the CPUs spent with nothing running, all CPUs together", [](const SimulationResult& r) { return r.idleTime; });
+        summary("sched_ready_length", "Ready processes, counted once per time unit", [](const Counters& c) -> const Histogram& { return c.readyLength; });
+        summary("sched_io_depth", "Processes doing IO, counted once per time unit", [](const Counters& c) -> const Histogram& { return c.ioDepth; });
+        summary("sched_decision_ticks", "Time stamp counter ticks from picking a process to it running, per dispatch", [](const Counters& c) -> const Histogram& { return c.decisionCycles; });
+        out.flush();
+    }
+    if (!out) { cout << "Could not write counters file " << path << endl; return false; }
+    return true;
+}
+#endif
+
+// Lane-batched Monte Carlo: //
+
+// Monte Carlo sweeps simulate thousands of small generated workloads, and for those most of the event loop's time goes on following PCB pointers and popping events rather than on the policy.
+// BatchKernel keeps every field of every process as a vector with one 32-bit lane per simulation instead, and advances all of its simulations together - one step takes every lane to its own
+// next event with the same instructions, so a step of BATCH_LANES simulations costs about as much as a step of one. Each step follows a pass of simulate() exactly (the same event order, the same
+// ready queue order and the same event count), so every lane's result is the one the engine gives for its workload. Only one CPU, and the schedulers whose ready queue comes down to the smallest
+// key and push order (FCFS, RR, SJF, SRTF and MLFQ), are batched - runSweep simulates everything else on the engine.
+
+const int BATCH_CHUNK = 256;  // Seeds a sweep task generates, and then simulates under each batched scheduler (and workloads a Monte Carlo benchmark round simulates)
+
+#if SCHED_SIMD
+#if defined(__AVX512F__)
+const int BATCH_LANES = 16;  // Simulations advanced together - one per 32-bit lane of the widest vectors the build targets (build with -march=native to get them)
+#elif defined(__AVX2__)
+const int BATCH_LANES = 8;
+#else
+const int BATCH_LANES = 4;  // SSE2 or NEON (and plain scalar instructions on a target with no vectors)
+#endif
+const int BATCH_PROCESSES = 32;  // Most processes a batched workload can have - every step goes over each of them
+const int32_t LANE_NEVER = INT32_MAX;  // Time (or sequence number) of something not pending
+
+typedef int32_t Lanes __attribute__((vector_size(4 * BATCH_LANES)));  // One value per simulation - GCC and Clang compile the arithmetic and compares to vector instructions, and a compare gives -1 in the lanes where it holds and 0 in the rest
+
+inline Lanes splat(int32_t v) { Lanes zero = {}; return zero + v; }  // v in every lane
+inline Lanes choose(Lanes mask, Lanes a, Lanes b) { return (a & mask) | (b & ~mask); }  // a in the lanes of mask, b in the rest
+inline Lanes lanesMin(Lanes a, Lanes b) { return choose(a < b, a, b); }
+inline bool anyLane(Lanes mask) { for (int l = 0; l < BATCH_LANES; l++) { if (mask[l] != 0) { return true; } } return false; }
+
+bool batchable(string scheduler, const SMPConfig& smp, const GeneratorConfig& generator) { // True if BatchKernel can simulate the scheduler on the generated workload
+    return smp.cpus == 1 && generator.processes > 0 && generator.processes <= BATCH_PROCESSES && (scheduler == "FCFS" || scheduler == "RR" || scheduler == "SJF" || scheduler == "SRTF" || scheduler == "MLFQ");
+}
+
+struct BatchWorkload { // One generated workload, unpacked for BatchKernel - made once per seed, then simulated under each batched scheduler
+    vector<int> arrivals;  // Arrival time of each process
+    vector<int> starts;   // Index of each process's first burst in bursts, then the number of bursts
+    vector<int> bursts;   // Bursts of every process, one process after another
+    void generate(const GeneratorConfig& config);  // Makes the processes the config and its seed give - the same ones ProcessStream creates
+};
+
+void BatchWorkload::generate(const GeneratorConfig& config) {
+    WorkloadGenerator generator(config);
+    vector<int> scratch;
+    arrivals.clear();  starts.clear();  bursts.clear();
+    while (generator.more()) {
+        arrivals.push_back(generator.nextArrival());  // Asked before generate(), which moves on to the next arrival
+        starts.push_back((int)bursts.size());
+        generator.generate(&scratch);
+        bursts.insert(bursts.end(), scratch.begin(), scratch.end());
+    }
+    starts.push_back((int)bursts.size());
+}
+
+class BatchKernel // Class BatchKernel simulates generated workloads on one CPU under FCFS, RR, SJF, SRTF or MLFQ, BATCH_LANES at a time with one vector lane each - a lane whose workload finishes is given the next one, so the lanes stay busy until the last few
+{
+public:
+    BatchKernel(string scheduler, const MLFQConfig& mlfq, const PolicyConfig& policies, const GeneratorConfig& generator);  // Explicit value constructor sets the policy and the size of the workloads
+    void run(const vector<BatchWorkload>& workloads, const vector<SimulationResult*>& results);  // Simulates each workload, filling in its result
+
+private:
+    Lanes is(int p, ProcessState s) { return state[p] == (int32_t)s; }  // Lanes where process p is in state s
+    Lanes burstAt(int p, Lanes index);  // Burst index[l] of process p in each lane l
+    void push(int p, Lanes mask);       // Process p goes to the back of the ready queue in the lanes of mask (its burstLeft and MLFQ level already set)
+    void boostLanes(Lanes mask);        // MLFQ priority boost in the lanes of mask
+    Lanes step();                       // One pass of the engine's event loop in every lane - returns the lanes whose workload finished
+    void load(int lane, const BatchWorkload& w);  // Starts a workload at t=0 in a lane
+    void unload(int lane);                        // Leaves a lane empty, so nothing in it is ever due
+    void finish(int lane, SimulationResult* r);   // Fills in the result of a lane's finished workload
+
+    bool bySize;      // True for SJF and SRTF, which order the ready queue by next CPU burst - otherwise it is MLFQ levels (FCFS and RR are one level)
+    bool preemptive;  // True if a ready process can take over the CPU (SRTF, and MLFQ levels)
+    int levels;       // Number of MLFQ levels
+    int32_t quanta[64];  // Time quantum of each MLFQ level (0 = run to the end of the burst)
+    int boost;        // MLFQ priority boost interval (0 = never)
+    int processes;    // Processes in every workload
+    int stride;       // Room for the bursts of one process (one more than the most a process can have, so the burst after the last can be read)
+    vector<int32_t> bursts;  // Burst i of process p in lane l is at (p * stride + i) * BATCH_LANES + l
+
+    // Every process (PCB fields, one lane per simulation):
+    Lanes state[BATCH_PROCESSES];     // ProcessState (NEW until it arrives)
+    Lanes index[BATCH_PROCESSES];     // dataIndex
+    Lanes count[BATCH_PROCESSES];     // dataSize
+    Lanes left[BATCH_PROCESSES];      // burstLeft
+    Lanes end[BATCH_PROCESSES];       // burstEnd, and the time it terminated once it has
+    Lanes since[BATCH_PROCESSES];     // Time it went into the ready queue
+    Lanes arrival[BATCH_PROCESSES];   // Arrival time
+    Lanes waited[BATCH_PROCESSES];    // waitingTime
+    Lanes response[BATCH_PROCESSES];  // responseTime (-1 until it first runs)
+    Lanes key[BATCH_PROCESSES];       // MLFQ level (0 = priority 1), or the next CPU burst for SJF and SRTF - the ready queue runs the smallest key first
+    Lanes order[BATCH_PROCESSES];     // Push order, which breaks ties between keys like the heap's sequence number and the level lists' FIFO order
+    Lanes ioSeq[BATCH_PROCESSES];     // Sequence number of its IO completion event
+
+    // Every simulation:
+    Lanes active;      // -1 if the lane has a workload
+    Lanes t;           // Current simulated time
+    Lanes quantum;     // Time quantum of the running process's level
+    Lanes quantumEnd;  // Time that quantum runs out
+    Lanes pushed;      // Pushes so far, for the push order
+    Lanes events;      // Events scheduled so far, for the sequence numbers and the result
+    Lanes idle;        // Time with nothing running
+    Lanes dispatches;  // Processes started running
+    Lanes arrivalAt;   // Time of the pending arrival event
+    Lanes arrivalSeq;  // and its sequence number
+    Lanes nextBoost;   // Time of the next priority boost
+    int slot[BATCH_LANES];  // Workload each lane is simulating
+};
+
+BatchKernel::BatchKernel(string scheduler, const MLFQConfig& mlfq, const PolicyConfig& policies, const GeneratorConfig& generator) {
+    MLFQConfig config = scheduler == "MLFQ" ? mlfq : makeMLFQConfig(1);  // FCFS and RR are single level MLFQs, as their policies are
+    if (scheduler == "RR") { config.quanta[0] = policies.rrQuantum; }
+    bySize = scheduler == "SJF" || scheduler == "SRTF";
+    preemptive = scheduler != "SJF" && scheduler != "FCFS" && scheduler != "RR";  // One level has nothing above it to preempt
+    levels = config.levels;  boost = bySize ? 0 : config.boostInterval;
+    for (int i = 0; i < 64; i++) { quanta[i] = bySize || i >= levels ? 0 : config.quanta[i]; }
+    processes = generator.processes;
+    stride = 2 * generator.maxBursts;
+    bursts.assign((size_t)processes * stride * BATCH_LANES, 0);
+}
+
+Lanes BatchKernel::burstAt(int p, Lanes i) {  // A gather - one load per lane
+    const int32_t* row = &bursts[(size_t)p * stride * BATCH_LANES];
+    Lanes v;
+    for (int l = 0; l < BATCH_LANES; l++) { v[l] = row[(i[l] > 0 ? i[l] : 0) * BATCH_LANES + l]; }  // A process that hasn't started has index -1
+    return v;
+}
+
+void BatchKernel::push(int p, Lanes m) {  // Like readyProcess and admitProcess, including the heap key of SJF and SRTF (nextBurst)
+    state[p] = choose(m, splat(READY), state[p]);
+    since[p] = choose(m, t, since[p]);
+    order[p] = choose(m, pushed, order[p]);
+    pushed -= m;  // Lanes of the mask are -1
+    if (bySize) { key[p] = choose(m, choose(left[p] > 0, left[p], burstAt(p, index[p] + 1)), key[p]); }
+}
+
+void BatchKernel::boostLanes(Lanes b) {  // Like MLFQPolicy::onPeriod - the lower levels join the back of the top level, highest level first and in order within each
+    Lanes movers[BATCH_PROCESSES];  // Ready processes below the top level
+    Lanes moved = {};
+    for (int p = 0; p < processes; p++) { movers[p] = b & is(p, READY) & (key[p] > 0);  moved -= movers[p]; }
+    Lanes rank[BATCH_PROCESSES];  // Place of each mover among the movers, by level then push order
+    for (int p = 0; p < processes; p++) {
+        rank[p] = pushed;
+        for (int q = 0; q < processes; q++) { rank[p] -= movers[q] & ((key[q] < key[p]) | ((key[q] == key[p]) & (order[q] < order[p]))); }
+    }
+    for (int p = 0; p < processes; p++) {
+        order[p] = choose(movers[p], rank[p], order[p]);
+        key[p] = choose(b & (is(p, READY) | is(p, WAITING)), splat(0), key[p]);
+        Lanes run = b & is(p, RUNNING) & (key[p] != 0);  // A running process below the top level starts a top level quantum now
+        key[p] = choose(run, splat(0), key[p]);
+        quantum = choose(run, splat(quanta[0]), quantum);
+        quantumEnd = choose(run, t + quanta[0], quantumEnd);
+        if (quanta[0] > 0) { events -= run; }  // Its QUANTUM_EXPIRE event
+    }
+    pushed += moved;
+    nextBoost = choose(b, nextBoost + boost, nextBoost);
+    events -= b;  // The next PRIORITY_BOOST event
+}
+
+Lanes BatchKernel::step() {  // Events that only wake the engine up (burst ends and quantum expiries of processes no longer running) change nothing, so each lane goes straight to its next real event
+    Lanes never = splat(LANE_NEVER);
+    if (boost > 0) {  // Time for the priority boost
+        Lanes b = active & (t >= nextBoost);
+        if (anyLane(b)) { boostLanes(b); }
+    }
+    while (true) {  // Handle every event due at t, one per lane at a time, in the order they were scheduled - IO completions and the arrival event
+        Lanes due = active & (arrivalAt <= t);
+        Lanes first = choose(due, arrivalSeq, never);
+        for (int p = 0; p < processes; p++) { first = lanesMin(first, choose(is(p, WAITING) & (end[p] <= t), ioSeq[p], never)); }
+        Lanes handling = active & (first != LANE_NEVER);
+        if (!anyLane(handling)) { break; }
+        for (int p = 0; p < processes; p++) {  // IO completion - back to the ready queue
+            Lanes m = handling & is(p, WAITING) & (ioSeq[p] == first);
+            left[p] = choose(m, splat(0), left[p]);
+            push(p, m);
+        }
+        Lanes arriving = due & (arrivalSeq == first);
+        if (anyLane(arriving)) {  // Admit each process that has arrived, then schedule the next arrival
+            Lanes next = never;
+            for (int p = 0; p < processes; p++) {
+                Lanes m = arriving & is(p, NEW) & (arrival[p] <= t);
+                key[p] = choose(m, splat(0), key[p]);  // MLFQ processes start at the top level
+                push(p, m);
+                next = lanesMin(next, choose(is(p, NEW), arrival[p], never));
+            }
+            arrivalAt = choose(arriving, next, arrivalAt);
+            Lanes more = arriving & (next != LANE_NEVER);
+            arrivalSeq = choose(more, events, arrivalSeq);
+            events -= more;
+        }
+    }
+
+    for (int p = 0; p < processes; p++) {  // The running process - end of burst or quantum (onTick)
+        Lanes run = is(p, RUNNING);
+        Lanes done = run & (t >= end[p]);
+        Lanes last = done & (index[p] + 1 >= count[p]);  // Finished its last burst - terminate
+        Lanes io = done & ~last;                          // Otherwise on to its IO burst
+        state[p] = choose(last, splat(TERMINATED), state[p]);
+        end[p] = choose(last, t, end[p]);
+        index[p] -= io;
+        left[p] = choose(io, burstAt(p, index[p]), left[p]);
+        state[p] = choose(io, splat(WAITING), state[p]);
+        end[p] = choose(io, t + left[p], end[p]);
+        ioSeq[p] = choose(io, events, ioSeq[p]);
+        events -= io;
+        if (!bySize) {  // Used up its quantum first - down a level (unless at the lowest) and to the back of the queue
+            Lanes expire = run & ~done & (quantum > 0) & (t >= quantumEnd);
+            key[p] = choose(expire & (key[p] < levels - 1), key[p] + 1, key[p]);
+            left[p] = choose(expire, end[p] - t, left[p]);
+            push(p, expire);
+        }
+    }
+    if (preemptive) {  // A ready process that should take over from the running one (shouldPreempt)
+        Lanes top = never;  // Smallest key in the ready queue
+        for (int p = 0; p < processes; p++) { top = lanesMin(top, choose(is(p, READY), key[p], never)); }
+        for (int p = 0; p < processes; p++) {
+            Lanes m = is(p, RUNNING) & (bySize ? top < end[p] - t : top < key[p]);  // Less time needed than the running process has left, or a higher level
+            left[p] = choose(m, end[p] - t, left[p]);
+            push(p, m);
+        }
+    }
+
+    Lanes busy = {};  // Lanes with a process running
+    Lanes bestKey = never, bestOrder = never;  // The ready process that runs next - smallest key, then first pushed
+    for (int p = 0; p < processes; p++) {
+        busy |= is(p, RUNNING);
+        Lanes better = is(p, READY) & ((key[p] < bestKey) | ((key[p] == bestKey) & (order[p] < bestOrder)));
+        bestKey = choose(better, key[p], bestKey);
+        bestOrder = choose(better, order[p], bestOrder);
+    }
+    Lanes pick = active & ~busy & (bestOrder != LANE_NEVER);
+    if (anyLane(pick)) {  // Dispatch
+        for (int p = 0; p < processes; p++) {
+            Lanes m = pick & is(p, READY) & (order[p] == bestOrder);  // Push orders of ready processes are all different
+            Lanes fresh = m & (left[p] <= 0);  // Starts its next burst (a preempted process carries on with its burst)
+            index[p] -= fresh;
+            left[p] = choose(fresh, burstAt(p, index[p]), left[p]);
+            waited[p] += choose(m, t - since[p], splat(0));
+            state[p] = choose(m, splat(RUNNING), state[p]);
+            end[p] = choose(m, t + left[p], end[p]);
+            response[p] = choose(m & (response[p] < 0), t - arrival[p], response[p]);
+        }
+        dispatches -= pick;
+        events -= pick;  // Its BURST_COMPLETE event
+        if (!bySize) {  // and a QUANTUM_EXPIRE event if its level has a quantum
+            Lanes q;
+            for (int l = 0; l < BATCH_LANES; l++) { q[l] = quanta[bestKey[l] >= 0 && bestKey[l] < levels ? bestKey[l] : 0]; }
+            quantum = choose(pick, q, quantum);
+            quantumEnd = choose(pick, t + q, quantumEnd);
+            events -= pick & (q > 0);
+        }
+        busy |= pick;
+    }
+
+    Lanes alive = {};  // Lanes with a process not yet terminated (including ones still to arrive)
+    Lanes next = lanesMin(arrivalAt, nextBoost);  // Time of each lane's next event
+    for (int p = 0; p < processes; p++) {
+        alive |= ~is(p, TERMINATED);
+        next = lanesMin(next, choose(is(p, RUNNING) | is(p, WAITING), end[p], never));
+    }
+    if (!bySize) { next = lanesMin(next, choose(busy & (quantum > 0), quantumEnd, never)); }
+    Lanes finished = active & ~alive;
+    Lanes going = active & alive;
+    idle += choose(going & ~busy, next - t, splat(0));  // Nothing ran until the next event
+    t = choose(going, next, t);
+    return finished;
+}
+
+void BatchKernel::load(int l, const BatchWorkload& w) {
+    for (int p = 0; p < processes; p++) {
+        int first = w.starts[p], n = w.starts[p + 1] - w.starts[p];
+        state[p][l] = NEW;  index[p][l] = -1;  count[p][l] = n;  left[p][l] = 0;  end[p][l] = 0;  since[p][l] = 0;
+        arrival[p][l] = w.arrivals[p];  waited[p][l] = 0;  response[p][l] = -1;  key[p][l] = 0;  order[p][l] = 0;  ioSeq[p][l] = 0;
+        for (int i = 0; i < n; i++) { bursts[((size_t)p * stride + i) * BATCH_LANES + l] = w.bursts[first + i]; }
+    }
+    active[l] = -1;  t[l] = 0;  quantum[l] = 0;  quantumEnd[l] = 0;  pushed[l] = 0;  idle[l] = 0;  dispatches[l] = 0;
+    events[l] = 0;  nextBoost[l] = LANE_NEVER;
+    if (boost > 0) { nextBoost[l] = boost;  events[l]++; }  // The first PRIORITY_BOOST event, then the first ARRIVAL event, like simulate()
+    arrivalAt[l] = w.arrivals[0];  arrivalSeq[l] = events[l]++;
+}
+
+void BatchKernel::unload(int l) {
+    for (int p = 0; p < processes; p++) { state[p][l] = TERMINATED; }
+    active[l] = 0;  arrivalAt[l] = LANE_NEVER;  nextBoost[l] = LANE_NEVER;
+}
+
+void BatchKernel::finish(int l, SimulationResult* r) {  // The process times are counted at the end rather than as each process terminates - the histograms come out the same in any order
+    r->totalTime = t[l];  r->idleTime = idle[l];  r->cpus = 1;  r->migrations = 0;  r->events = events[l];
+    r->metrics = Metrics();
+    r->metrics.dispatches = dispatches[l];
+    for (int p = 0; p < processes; p++) {
+        r->metrics.waiting.add(waited[p][l]);
+        r->metrics.turnaround.add(end[p][l] - arrival[p][l]);
+        r->metrics.response.add(response[p][l]);
+    }
+}
+
+void BatchKernel::run(const vector<BatchWorkload>& workloads, const vector<SimulationResult*>& results) {
+    size_t next = 0;  // Next workload to start
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (next < workloads.size()) { slot[l] = (int)next;  load(l, workloads[next++]); } else { unload(l); }
+    }
+    while (anyLane(active)) {
+        Lanes finished = step();
+        for (int l = 0; l < BATCH_LANES; l++) {
+            if (finished[l] == 0) { continue; }
+            finish(l, results[slot[l]]);
+            if (next < workloads.size()) { slot[l] = (int)next;  load(l, workloads[next++]); } else { unload(l); }  // Refill the lane
+        }
+    }
+}
+#endif
+
+
+class WorkStealingPool // Class WorkStealingPool runs numbered tasks on a set of worker threads - each worker has its own queue of tasks, and a worker whose queue runs dry steals from the others, so long and short simulations even out
+{
+public:
+    WorkStealingPool(int threads) : queues(threads > 0 ? threads : 1) {}  // Explicit value constructor sets the number of workers
+    template <class Task> void run(int tasks, Task task);  // Runs task(0) to task(tasks - 1), returning once all are done
+
+private:
+    struct WorkerQueue { // Tasks waiting for one worker
+        mutex lock;        // Guards the tasks (the owner and thieves both take from it)
+        deque<int> tasks; // Numbers of the tasks - the owner takes from the back, thieves from the front
+    };
+    bool take(int worker, int* task);  // Gets the next task for a worker, stealing if its own queue is empty - false once every queue is empty
+
+    vector<WorkerQueue> queues;  // One queue per worker
+};
+
+bool WorkStealingPool::take(int worker, int* task) {  // No task makes new tasks, so once every queue is empty the worker is finished
+    int workers = (int)queues.size();
+    for (int i = 0; i < workers; i++) {  // Own queue first, then the others in turn
+        WorkerQueue& queue = queues[(worker + i) % workers];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) { continue; }
+        if (i == 0) { *task = queue.tasks.back();  queue.tasks.pop_back(); }  // Own work, newest first
+        else { *task = queue.tasks.front();  queue.tasks.pop_front(); }     // Stolen work, from the far end to the owner
+        return true;
+    }
+    return false;
+}
+
+template <class Task>
+void WorkStealingPool::run(int tasks, Task task) {  // Deals the tasks out in blocks, one per worker, then starts the workers
+    int workers = (int)queues.size();
+    for (int i = 0; i < tasks; i++) { queues[(long long)i * workers / tasks].tasks.push_front(i); }  // Block w gets tasks w*tasks/workers onwards (pushed to the front so the owner runs them in order)
+    vector<thread> threads;
+    for (int w = 0; w < workers; w++) {
+        threads.push_back(thread([this, w, &task]() {
+            int next;
+            while (take(w, &next)) { task(next); }  // Work until there is nothing left anywhere
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) { threads[i].join(); }  // Wait for every worker
+}
+
+struct SweepCell { // One simulation of a sweep
+    string scheduler;  // Scheduler to simulate
+    MLFQConfig mlfq;   // MLFQ parameters (only used by MLFQ)
+    SMPConfig smp;     // Number of CPUs and balancing policy
+    uint64_t seed;     // Seed of the generated workload (only used when generating)
+    int group;         // Seed and CPU setup it shares a warm-up with
+};
+
+void runSweep(const vector<string>& schedulers, const vector<MLFQConfig>& mlfqs, const PolicyConfig& policies, const vector<SMPConfig>& smps, const vector<uint64_t>& seeds, Workload& workload, const GeneratorConfig& generator, int threads, int forkAt, string warmup, string countersPath, string countersFormat, bool scalar) { // Runs every combination of scheduler, MLFQ parameters, CPU setup and seed on a thread pool, then prints one table of the results - if forkAt is not -1, each seed and CPU setup is simulated under warmup until forkAt once, and its simulations all carry on from there (and if countersPath is given, the counters of every simulation are written to it) - generated workloads on one CPU are simulated BATCH_LANES at a time by BatchKernel, unless scalar is true
+    vector<SweepCell> cells;  // Every simulation, in table order
+    bool generating = generator.processes > 0;
+    for (size_t s = 0; s < (generating ? seeds.size() : 1); s++) {  // Seeds only matter for generated workloads
+        for (size_t i = 0; i < schedulers.size(); i++) {
+            for (size_t m = 0; m < (schedulers[i] == "MLFQ" ? mlfqs.size() : 1); m++) {  // MLFQ parameters only matter for MLFQ
+                for (size_t c = 0; c < smps.size(); c++) {
+                    SweepCell cell = { schedulers[i], mlfqs[m], smps[c], generating ? seeds[s] : 0, (int)(s * smps.size() + c) };
+                    cells.push_back(cell);
+                }
+            }
+        }
+    }
+    vector<SimulationResult> results(cells.size());  // Each simulation writes only its own result
+    WorkStealingPool pool(threads);
+    int groups = forkAt >= 0 ? (int)((generating ? seeds.size() : 1) * smps.size()) : 0;
+    vector<Snapshot> warmups(groups);  // Shared warm-up of each group - only read once taken, so the simulations of a group can all carry on from it at once
+    pool.run(groups, [&](int g) {
+        GeneratorConfig config = generator;
+        config.seed = generating ? seeds[g / smps.size()] : generator.seed;
+        runSimulation(warmup, mlfqs[0], policies, smps[g % smps.size()], workload, config, OUTPUT_NONE, NULL, forkAt, &warmups[g]);
+    });
+    vector<int> single;  // Cells simulated one at a time on the engine
+    vector<int> batched;  // Cells of the first seed that BatchKernel simulates for every seed (the cells of seed s are s * perSeed on from these)
+#if SCHED_SIMD
+    int perSeed = (int)(cells.size() / (generating ? seeds.size() : 1));
+#else
+    (void)scalar;  // Nothing is batched
+#endif
+    for (size_t i = 0; i < cells.size(); i++) {
+#if SCHED_SIMD
+        if (!scalar && groups == 0 && countersPath == "" && batchable(cells[i].scheduler, cells[i].smp, generator)) {  // Warm-ups and counters need the engine
+            if ((int)i < perSeed) { batched.push_back((int)i); }
+            continue;
+        }
+#endif
+        single.push_back((int)i);
+    }
+    int chunks = batched.empty() ? 0 : (int)((seeds.size() + BATCH_CHUNK - 1) / BATCH_CHUNK);  // Batch tasks, each a run of seeds
+    pool.run(chunks + (int)single.size(), [&](int task) {
+        if (task >= chunks) {
+            int i = single[task - chunks];
+            GeneratorConfig config = generator;  // Workload files and the sample are shared by every simulation - generated workloads are made by each one from its seed
+            config.seed = cells[i].seed;
+            results[i] = runSimulation(cells[i].scheduler, cells[i].mlfq, policies, cells[i].smp, workload, config, OUTPUT_NONE, groups > 0 ? &warmups[cells[i].group] : NULL);
+            return;
+        }
+#if SCHED_SIMD
+        size_t first = (size_t)task * BATCH_CHUNK, last = min(seeds.size(), first + BATCH_CHUNK);
+        vector<BatchWorkload> chunk(last - first);  // Each seed's workload is generated once for all of the batched schedulers
+        for (size_t s = first; s < last; s++) {
+            GeneratorConfig config = generator;
+            config.seed = seeds[s];
+            chunk[s - first].generate(config);
+        }
+        for (size_t b = 0; b < batched.size(); b++) {
+            const SweepCell& cell = cells[batched[b]];
+            BatchKernel kernel(cell.scheduler, cell.mlfq, policies, generator);
+            vector<SimulationResult*> out;
+            for (size_t s = first; s < last; s++) { out.push_back(&results[s * perSeed + batched[b]]); }
+            kernel.run(chunk, out);
+        }
+#endif
+    });
+
+    if (groups > 0) { cout << "Every simulation carries on from " << warmup << " at time " << forkAt << " (or starts at t=0 if every process finished first)" << endl; }
+
+    cout << "Scheduler  MLFQ quanta     Boost  CPUs  Balance  Seed        Total time  CPU %     Migrations  Avg Tw      Avg Ttr     Avg Tr      p99 Tw      p99 Ttr     p99 Tr" << endl;  // Header of the table
+#if SCHED_COUNTERS
+    vector<CounterLabels> labels;  // Labels of each simulation's counters - the columns that tell it apart
+#endif
+    for (size_t i = 0; i < cells.size(); i++) {  // One line per simulation, in the order they were listed
+        string quanta = "-";  // MLFQ columns are blank for the other schedulers
+        string boost = "-";
+        if (cells[i].scheduler == "MLFQ") {
+            quanta = "";
+            for (size_t q = 0; q < cells[i].mlfq.quanta.size(); q++) { quanta += (q > 0 ? "," : "") + to_string(cells[i].mlfq.quanta[q]); }
+            boost = to_string(cells[i].mlfq.boostInterval);
+        }
+        else if (cells[i].scheduler == "RR") { quanta = to_string(policies.rrQuantum); }  // Round Robin's single quantum
+        const SMPConfig& smp = cells[i].smp;
+        string balance = smp.cpus == 1 ? "-" : smp.balance == BALANCE_GLOBAL ? "global" : smp.balance == BALANCE_PUSH ? "push" : "steal";  // Balancing only matters with more than one CPU
+        cout << left << setw(11) << cells[i].scheduler << setw(16) << quanta << setw(7) << boost << setw(6) << smp.cpus << setw(9) << balance << setw(12) << (generating ? to_string(cells[i].seed) : string("-"));
+#if SCHED_COUNTERS
+        labels.push_back(CounterLabels{ { "scheduler", cells[i].scheduler }, { "quanta", quanta }, { "boost", boost }, { "cpus", to_string(smp.cpus) }, { "balance", balance }, { "seed", generating ? to_string(cells[i].seed) : string("-") } });
+#endif
+        const SimulationResult& r = results[i];
+        if (r.totalTime < 0) { cout << "did not finish" << endl; continue; }
+        cout << setw(12) << r.totalTime << fixed << setprecision(2) << setw(10) << (r.totalTime > 0 ? (1 - (double)r.idleTime / ((double)r.totalTime * r.cpus)) * 100 : 0.0)
+             << setw(12) << r.migrations << setw(12) << r.metrics.waiting.mean() << setw(12) << r.metrics.turnaround.mean() << setw(12) << r.metrics.response.mean()
+             << setw(12) << r.metrics.waiting.percentile(99) << setw(12) << r.metrics.turnaround.percentile(99) << r.metrics.response.percentile(99) << endl;
+        cout.unsetf(ios::fixed);  cout << setprecision(6) << right;  // Back to the default format
+    }
+#if SCHED_COUNTERS
+    if (countersPath != "") { writeCounters(countersPath, countersFormat, labels, results); }
+#else
+    (void)countersPath;  (void)countersFormat;  // Counters are compiled out
+#endif
+}
+
+
+// Benchmarks: //
+
+struct BenchResult { // Measurements of one benchmark, sent back from the child process that ran it
+    char name[32];          // Scheduler and number of processes, or the helper measured
+    int processes;          // Number of processes simulated (or PCBs the helper was measured on)
+    long long runs;         // Times the benchmark was repeated
+    double seconds;         // Wall time of all the runs
+    long long events;       // Events scheduled in all the runs (calls, for a helper)
+    long long decisions;    // Processes started running in all the runs (calls, for a helper)
+    long long allocations;  // Allocations made in all the runs
+    long peakKB;            // Peak resident set size of the child process, in KB
+};
+
+double secondsSince(chrono::steady_clock::time_point start) { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); }
+
+template <class Body>
+bool runBenchmark(BenchResult* r, Body body) { // Runs body in a child process, so each benchmark gets a fresh heap and its own peak RSS - returns false if the child failed
+    int fds[2];
+    if (pipe(fds) != 0) { cout << "Could not create a pipe for " << r->name << endl; return false; }
+    cout.flush();  // So the child doesn't print what the parent had buffered
+    pid_t pid = fork();
+    if (pid < 0) { cout << "Could not fork for " << r->name << endl; ::close(fds[0]); ::close(fds[1]); return false; }
+    if (pid == 0) {  // Child: run the benchmark and send back what it measured
+        ::close(fds[0]);
+        body(r);
+        bool sent = write(fds[1], r, sizeof(*r)) == (ssize_t)sizeof(*r);
+        _exit(sent ? 0 : 1);
+    }
+    ::close(fds[1]);
+    bool ok = read(fds[0], r, sizeof(*r)) == (ssize_t)sizeof(*r);
+    ::close(fds[0]);
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) { ok = false; }
+#ifdef __APPLE__
+    r->peakKB = usage.ru_maxrss / 1024;  // Bytes on macOS
+#else
+    r->peakKB = usage.ru_maxrss;        // KB on Linux
+#endif
+    if (!ok) { cout << "Benchmark " << r->name << " failed" << endl; }
+    return ok;
+}
+
+void benchSimulation(BenchResult* r, string scheduler, const MLFQConfig& mlfq, const PolicyConfig& policies, const SMPConfig& smp, Workload& workload, const GeneratorConfig& generator) { // Simulates the generated workload until at least 0.2s have gone by
+    auto start = chrono::steady_clock::now();
+    do {
+        uint64_t before = allocations;
+        SimulationResult s = runSimulation(scheduler, mlfq, policies, smp, workload, generator, OUTPUT_NONE);
+        r->allocations += allocations - before;
+        r->events += s.events;  r->decisions += s.metrics.dispatches;  r->runs++;
+    } while (secondsSince(start) < 0.2);
+    r->seconds = secondsSince(start);
+}
+
+void benchMonteCarlo(BenchResult* r, string scheduler, const MLFQConfig& mlfq, const PolicyConfig& policies, const SMPConfig& smp, Workload& workload, GeneratorConfig generator, bool batched) { // Simulates small generated workloads with one seed after another, BATCH_CHUNK at a time on the engine or batched, until at least 0.2s have gone by (each workload is a run)
+    auto start = chrono::steady_clock::now();
+    do {
+#if SCHED_SIMD
+        if (batched) {
+            vector<BatchWorkload> chunk(BATCH_CHUNK);
+            vector<SimulationResult> results(BATCH_CHUNK);
+            vector<SimulationResult*> out;
+            uint64_t before = allocations;
+            for (int i = 0; i < BATCH_CHUNK; i++) { generator.seed = r->runs + i + 1;  chunk[i].generate(generator);  out.push_back(&results[i]); }
+            BatchKernel kernel(scheduler, mlfq, policies, generator);
+            kernel.run(chunk, out);
+            r->allocations += allocations - before;
+            for (int i = 0; i < BATCH_CHUNK; i++) { r->events += results[i].events;  r->decisions += results[i].metrics.dispatches; }
+            r->runs += BATCH_CHUNK;
+            continue;
+        }
+#else
+        (void)batched;  // Nothing is batched
+#endif
+        for (int i = 0; i < BATCH_CHUNK; i++) {
+            generator.seed = r->runs + 1;
+            uint64_t before = allocations;
+            SimulationResult s = runSimulation(scheduler, mlfq, policies, smp, workload, generator, OUTPUT_NONE);
+            r->allocations += allocations - before;
+            r->events += s.events;  r->decisions += s.metrics.dispatches;  r->runs++;
+        }
+    } while (secondsSince(start) < 0.2);
+    r->seconds = secondsSince(start);
+}
+
+void benchHelper(BenchResult* r, const GeneratorConfig& generator, int helper) { // Times one of the hot PCB helpers on its own, over a ready queue of generator.processes PCBs, until at least 0.2s have gone by
+    double timed = 0;  // Time spent in the helper itself (setting up the PCBs between rounds is not counted)
+    auto start = chrono::steady_clock::now();
+    do {
+        ProcessStream stream(generator, false);
+        vector<PCB*> pcbs;
+        while (stream.more()) { pcbs.push_back(stream.create()); }
+        PCB* running = NULL;  PCB* waiting = NULL;
+        ReadyHeap heap;
+        MLFQQueues levels(3, 5);
+        int calls = (int)pcbs.size();  // Calls made in this round
+        uint64_t before = allocations;
+        chrono::steady_clock::time_point t0;
+        if (helper == 0) {  // ReadyHeap top/remove/push (getShortest): run the shortest job and put it straight back, over and over
+            for (PCB* p : pcbs) { p->admitProcess(&heap, 0); }
+            t0 = chrono::steady_clock::now();
+            for (int i = 0; i < calls; i++) { PCB* p = heap.top();  p->runProcess(&heap, &running, i);  p->readyProcess(&running, &heap, i, TRACE_PREEMPTED); }
+        }
+        else if (helper == 1) {  // MLFQQueues first/remove/push (getFirstPriority): the same with the MLFQ levels
+            for (PCB* p : pcbs) { p->admitProcess(&levels, 0); }
+            t0 = chrono::steady_clock::now();
+            for (int i = 0; i < calls; i++) { PCB* p = levels.first();  p->runProcess(&levels, &running, i);  p->readyProcess(&running, &levels, i, TRACE_PREEMPTED); }
+        }
+        else if (helper == 2) {  // waitManage: every process finishes its IO, back into the MLFQ levels
+            for (PCB* p : pcbs) { p->admitProcess(&levels, 0);  p->incrementPC();  p->runProcess(&levels, &running, 0);  p->incrementPC();  p->waitProcess(&running, &waiting, 0); }
+            t0 = chrono::steady_clock::now();
+            for (PCB* p : pcbs) { p->waitManage(&waiting, &levels, INT32_MAX); }
+        }
+        else {  // incrementPC (programCounter): step each process through all of its bursts
+            t0 = chrono::steady_clock::now();
+            calls = 0;
+            for (PCB* p : pcbs) { int n = p->burstCount();  for (int b = 0; b < n; b++) { p->incrementPC(); }  calls += n; }
+        }
+        timed += secondsSince(t0);
+        r->allocations += allocations - before;
+        r->events += calls;  r->decisions += calls;  r->runs++;
+    } while (secondsSince(start) < 0.2);
+    r->seconds = timed;
+}
+
+void runBenchmarks(const vector<string>& schedulers, const vector<int>& sizes, const MLFQConfig& mlfq, const PolicyConfig& policies, const SMPConfig& smp, Workload& workload, GeneratorConfig generator, string outPath, string baselinePath) { // Benchmarks every scheduler on generated workloads of each size, then the hot helpers, printing a table and writing a JSON baseline
+    vector<BenchResult> results;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        for (size_t j = 0; j < schedulers.size(); j++) {
+            BenchResult r;
+            memset(&r, 0, sizeof(r));
+            snprintf(r.name, sizeof(r.name), "%s/%d", schedulers[j].c_str(), sizes[i]);
+            r.processes = sizes[i];
+            generator.processes = sizes[i];
+            if (runBenchmark(&r, [&](BenchResult* b) { benchSimulation(b, schedulers[j], mlfq, policies, smp, workload, generator); })) { results.push_back(r); }
+        }
+    }
+#if SCHED_SIMD
+    GeneratorConfig small = generator;  // Monte Carlo: many small workloads (as many processes as the sample), on the engine and then batched
+    small.processes = 8;
+    SMPConfig one = smp;
+    one.cpus = 1;
+    for (size_t j = 0; j < schedulers.size(); j++) {
+        if (!batchable(schedulers[j], one, small)) { continue; }
+        for (int batched = 0; batched < 2; batched++) {
+            BenchResult r;
+            memset(&r, 0, sizeof(r));
+            snprintf(r.name, sizeof(r.name), "%s/8x%s", schedulers[j].c_str(), batched ? "batch" : "runs");
+            r.processes = small.processes;
+            if (runBenchmark(&r, [&](BenchResult* b) { benchMonteCarlo(b, schedulers[j], mlfq, policies, one, workload, small, batched == 1); })) { results.push_back(r); }
+        }
+    }
+#endif
+    const char* helpers[] = { "getShortest", "getFirstPriority", "waitManage", "programCounter" };  // Named after what each helper was called in the original simulator
+    generator.processes = 10000;  // Helpers are timed over 10^4 PCBs
+    for (int h = 0; h < 4; h++) {
+        BenchResult r;
+        memset(&r, 0, sizeof(r));
+        snprintf(r.name, sizeof(r.name), "%s", helpers[h]);
+        r.processes = generator.processes;
+        if (runBenchmark(&r, [&](BenchResult* b) { benchHelper(b, generator, h); })) { results.push_back(r); }
+    }
+
+    vector<pair<string, double> > baseline;  // ns per decision of each benchmark in the baseline file
+    if (baselinePath != "") {  // Baseline lines are the ones written below - one benchmark per line
+        ifstream in(baselinePath);
+        if (!in) { cout << "Could not open baseline " << baselinePath << endl; }
+        string line;
+        while (getline(in, line)) {
+            size_t name = line.find("\"name\":\""), ns = line.find("\"ns_per_decision\":");
+            if (name == string::npos || ns == string::npos) { continue; }
+            name += 8;
+            baseline.push_back(make_pair(line.substr(name, line.find('"', name) - name), atof(line.c_str() + ns + 18)));
+        }
+    }
+
+    cout << "Benchmark               Runs      Events/s      ns/decision   Peak RSS MB   Allocs/event" << (baseline.empty() ? "" : "  vs baseline") << endl;
+    FILE* out = outPath == "" ? NULL : fopen(outPath.c_str(), "w");
+    if (outPath != "" && out == NULL) { cout << "Could not create " << outPath << endl; }
+    if (out != NULL) { fprintf(out, "{\"benchmarks\":[\n"); }
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        double eventsPerSec = r.seconds > 0 ? r.events / r.seconds : 0;
+        double nsPerDecision = r.decisions > 0 ? r.seconds * 1e9 / r.decisions : 0;
+        double allocsPerEvent = r.events > 0 ? (double)r.allocations / r.events : 0;
+        cout << left << setw(24) << r.name << setw(10) << r.runs << fixed << setprecision(0) << setw(14) << eventsPerSec << setprecision(1) << setw(14) << nsPerDecision
+             << setw(14) << r.peakKB / 1024.0 << setprecision(4) << setw(14) << allocsPerEvent;
+        for (size_t b = 0; b < baseline.size(); b++) {  // Change in ns per decision (negative is faster)
+            if (baseline[b].first == r.name && baseline[b].second > 0) { cout << showpos << setprecision(1) << (nsPerDecision / baseline[b].second - 1) * 100 << "%" << noshowpos; }
+        }
+        cout << endl;
+        cout.unsetf(ios::fixed);  cout << setprecision(6) << right;  // Back to the default format
+        if (out != NULL) {
+            fprintf(out, "{\"name\":\"%s\",\"processes\":%d,\"runs\":%lld,\"seconds\":%.6f,\"events\":%lld,\"decisions\":%lld,\"events_per_sec\":%.0f,\"ns_per_decision\":%.2f,\"peak_rss_kb\":%ld,\"allocs_per_event\":%.4f}%s\n",
+                    r.name, r.processes, r.runs, r.seconds, r.events, r.decisions, eventsPerSec, nsPerDecision, r.peakKB, allocsPerEvent, i + 1 < results.size() ? "," : "");
+        }
+    }
+    if (out != NULL) { fprintf(out, "]}\n");  fclose(out); }
+}
+
+
+bool validScheduler(string name) { // True if name is one of the schedulers, printing the valid ones if it is not
+    if (name == "SJF" || name == "SRTF" || name == "FCFS" || name == "MLFQ" || name == "RR" || name == "PRIO" || name == "CFS" || name == "STRIDE") { return true; }
+    cout << "Invalid scheduling type " << name << " (valid types are SJF, SRTF, FCFS, MLFQ, RR, PRIO, CFS and STRIDE)" << endl;
+    return false;
+}
+
+bool parseBalance(string text, BalancePolicy* policy) { // Reads a balancing policy name, returning false (with a message) if it is not one
+    if (text == "global") { *policy = BALANCE_GLOBAL; }
+    else if (text == "push") { *policy = BALANCE_PUSH; }
+    else if (text == "steal") { *policy = BALANCE_STEAL; }
+    else { cout << "Invalid balancing policy " << text << " (use global, push or steal)" << endl; return false; }
+    return true;
+}
+
+vector<int> parseIntList(string text) { // Splits a comma separated list of numbers such as "5,10,0"
+    vector<int> values;  // Numbers found so far
+    size_t start = 0;   // Start of the current number
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);  // End of the current number
+        if (comma == string::npos) { comma = text.size(); }
+        values.push_back(atoi(text.substr(start, comma - start).c_str()));  // Convert and save it
+        start = comma + 1;  // Next number starts after the comma
+    }
+    return values;
+}
+
+int main(int argc, char* argv[]) // Usage: scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] [--workload FILE] [--mlfq-levels N] [--mlfq-quanta q1,q2,...] [--mlfq-boost T]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] [--rr-quantum Q] [--priority-levels N] [--aging T] [--nice N1,N2,...] [--cfs-latency T] [--cfs-granularity T] [--tickets N1,N2,...] [other options]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] --generate N [--seed S] [--gen-cpu DIST] [--gen-io DIST] [--gen-bursts MIN:MAX] [--gen-arrival DIST|none]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] --sweep [--sweep-quanta q1,q2/q1,q2,q3/...] [--sweep-boost T1,T2,...] [--seeds A-B|S1,S2,...] [--threads N] [--no-batch] [workload or generator options]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] --cpus K [--balance global|push|steal] [--balance-interval T] [--migration-cost C] [workload or generator options]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] [--quiet | --summary json|csv] [--trace FILE] [--counters FILE|- [--counters-format prometheus|json]] [other options]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] --fork-at T [--warmup SCHED] [--snapshot FILE] [--sweep options] [other options]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] --restore FILE [workload or generator options] [other options]
+                                 //        scheduler SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE --stream -|FILE [other options]
+                                 //        scheduler SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE --stream-trace -|TRACE [--import-unit US] [--import-split T] [other options]
+                                 //        scheduler --convert TEXTFILE FILE
+                                 //        scheduler --import-trace -|TRACE -|TEXTFILE [--import-unit US] [--import-split T]
+                                 //        scheduler --render FILE [--render-format text|chrome]
+                                 //        scheduler [SJF|SRTF|FCFS|MLFQ|RR|PRIO|CFS|STRIDE ...] --bench [--bench-sizes N1,N2,...] [--bench-out FILE] [--bench-baseline FILE] [other options]
+{
+    vector<string> schedulers;  // Schedulers to simulate, in the order given
+    int levels = 0;            // Number of MLFQ levels (0 = not given)
+    string quanta = "";       // MLFQ quanta as given on the command line
+    int boost = 0;           // MLFQ priority boost interval (0 = no boost)
+    string workloadPath = ""; // Binary workload file to simulate (empty = the sample processes)
+    string streamPath = "";  // Text stream to read arriving processes from while simulating ("-" = stdin, empty = no stream)
+    bool streamTrace = false;  // True if the stream is a Linux scheduler trace rather than a text workload
+    string importPath = "";   // Linux scheduler trace to import as a text workload instead of simulating ("-" = stdin, empty = don't import)
+    string importOut = "";   // Text workload to write it to ("-" = stdout)
+    ImportConfig importConfig = { 10, 100000 };  // Imported traces are in 10us time units, and a task is split after 1s asleep or as one process
+    GeneratorConfig generator = makeGeneratorConfig();  // Generated workload parameters (processes = 0 unless --generate is given)
+    bool sweep = false;         // True to run every combination of the sweep options in parallel and print one table
+    string sweepQuanta = "";   // MLFQ quanta sets to sweep, separated by '/' (empty = just the MLFQ options)
+    string sweepBoost = "";   // MLFQ boost intervals to sweep (empty = just --mlfq-boost)
+    string seedList = "";    // Seeds to sweep, as a range A-B or a list (empty = just --seed)
+    int threads = (int)thread::hardware_concurrency();  // Worker threads for a sweep (default one per core)
+    bool scalar = false;       // True to simulate every sweep cell on the engine, rather than batching generated workloads on one CPU
+    PolicyConfig policyConfig = { 5, 4, 10, vector<int>(1, 0), 24, 3, vector<int>(1, 100) };  // Round Robin quantum 5, 4 priorities aged every 10 time units, every process at nice 0 with a CFS period of 24 and slices of at least 3, and 100 stride tickets each
+    SMPConfig smp = { 1, BALANCE_STEAL, 10, 0 };  // Simulated CPUs - one by default, like the original
+    string balance = "steal";  // Balancing policy as given on the command line
+    string sweepCPUs = "";    // Numbers of CPUs to sweep (empty = just --cpus)
+    string sweepBalance = ""; // Balancing policies to sweep (empty = just --balance)
+    OutputLevel output = OUTPUT_STEPS;  // Print every step unless --quiet
+    string tracePath = "";    // Trace file to record every state change in (empty = no trace)
+    string renderPath = "";  // Trace file to render instead of simulating (empty = simulate)
+    string renderFormat = "text";  // How to render it
+    string summary = "";     // Print only a json or csv summary of each simulation (empty = the results tables)
+    bool bench = false;      // True to benchmark the simulator instead of printing simulations
+    string benchSizes = "100,1000,10000,100000,1000000";  // Numbers of processes to benchmark each scheduler with
+    string benchOut = "";       // JSON file to write the benchmark results to (empty = just print them)
+    string benchBaseline = "";  // JSON file of earlier benchmark results to compare with
+    int forkAt = -1;            // Time to take the warm-up snapshot at (-1 = no warm-up)
+    string warmup = "";        // Scheduler to warm up under (empty = the first scheduler)
+    string snapshotPath = "";  // Snapshot file to save the warm-up in (empty = keep it in memory)
+    string restorePath = "";  // Snapshot file to carry on from instead of warming up (empty = none)
+    string countersPath = "";  // File to write the instrumentation counters of every simulation to ("-" = stdout, empty = don't count)
+    string countersFormat = "prometheus";  // How to write them
+    for (int i = 1; i < argc; i++) {  // Go through the command line arguments
+        string arg = argv[i];
+        if (arg == "--mlfq-levels" && i + 1 < argc) { levels = atoi(argv[++i]); }
+        else if (arg == "--mlfq-quanta" && i + 1 < argc) { quanta = argv[++i]; }
+        else if (arg == "--mlfq-boost" && i + 1 < argc) { boost = atoi(argv[++i]); }
+        else if (arg == "--rr-quantum" && i + 1 < argc) { policyConfig.rrQuantum = atoi(argv[++i]); }
+        else if (arg == "--priority-levels" && i + 1 < argc) { policyConfig.priorityLevels = atoi(argv[++i]); }
+        else if (arg == "--aging" && i + 1 < argc) { policyConfig.agingInterval = atoi(argv[++i]); }
+        else if (arg == "--nice" && i + 1 < argc) { policyConfig.nice = parseIntList(argv[++i]); }
+        else if (arg == "--cfs-latency" && i + 1 < argc) { policyConfig.cfsLatency = atoi(argv[++i]); }
+        else if (arg == "--cfs-granularity" && i + 1 < argc) { policyConfig.cfsGranularity = atoi(argv[++i]); }
+        else if (arg == "--tickets" && i + 1 < argc) { policyConfig.tickets = parseIntList(argv[++i]); }
+        else if (arg == "--workload" && i + 1 < argc) { workloadPath = argv[++i]; }
+        else if (arg == "--stream" && i + 1 < argc) { streamPath = argv[++i]; }
+        else if (arg == "--stream-trace" && i + 1 < argc) { streamPath = argv[++i];  streamTrace = true; }
+        else if (arg == "--import-trace" && i + 2 < argc) { importPath = argv[++i];  importOut = argv[++i]; }
+        else if (arg == "--import-unit" && i + 1 < argc) { importConfig.unit = atoi(argv[++i]); }
+        else if (arg == "--import-split" && i + 1 < argc) { importConfig.split = atoi(argv[++i]); }
+        else if (arg == "--generate" && i + 1 < argc) { generator.processes = atoi(argv[++i]); }
+        else if (arg == "--seed" && i + 1 < argc) { generator.seed = strtoull(argv[++i], NULL, 10); }
+        else if (arg == "--gen-cpu" && i + 1 < argc) { if (!generator.cpu.parse(argv[++i])) { return 1; } }
+        else if (arg == "--gen-io" && i + 1 < argc) { if (!generator.io.parse(argv[++i])) { return 1; } }
+        else if (arg == "--gen-bursts" && i + 1 < argc) {  // MIN:MAX CPU bursts per process
+            string range = argv[++i];
+            size_t colon = range.find(':');
+            generator.minBursts = atoi(range.c_str());
+            generator.maxBursts = colon == string::npos ? generator.minBursts : atoi(range.c_str() + colon + 1);
+        }
+        else if (arg == "--gen-arrival" && i + 1 < argc) {  // Time between arrivals, or none for every process at t=0
+            string gap = argv[++i];
+            generator.arrivals = gap != "none";
+            if (generator.arrivals && !generator.arrivalGap.parse(gap)) { return 1; }
+        }
+        else if (arg == "--cpus" && i + 1 < argc) { smp.cpus = atoi(argv[++i]); }
+        else if (arg == "--balance" && i + 1 < argc) { balance = argv[++i]; }
+        else if (arg == "--balance-interval" && i + 1 < argc) { smp.balanceInterval = atoi(argv[++i]); }
+        else if (arg == "--migration-cost" && i + 1 < argc) { smp.migrationCost = atoi(argv[++i]); }
+        else if (arg == "--sweep") { sweep = true; }
+        else if (arg == "--sweep-cpus" && i + 1 < argc) { sweepCPUs = argv[++i]; }
+        else if (arg == "--sweep-balance" && i + 1 < argc) { sweepBalance = argv[++i]; }
+        else if (arg == "--sweep-quanta" && i + 1 < argc) { sweepQuanta = argv[++i]; }
+        else if (arg == "--sweep-boost" && i + 1 < argc) { sweepBoost = argv[++i]; }
+        else if (arg == "--seeds" && i + 1 < argc) { seedList = argv[++i]; }
+        else if (arg == "--threads" && i + 1 < argc) { threads = atoi(argv[++i]); }
+        else if (arg == "--no-batch") { scalar = true; }
+        else if (arg == "--quiet") { output = OUTPUT_RESULTS; }
+        else if (arg == "--summary" && i + 1 < argc) { summary = argv[++i]; }
+        else if (arg == "--bench") { bench = true; }
+        else if (arg == "--bench-sizes" && i + 1 < argc) { benchSizes = argv[++i]; }
+        else if (arg == "--bench-out" && i + 1 < argc) { benchOut = argv[++i]; }
+        else if (arg == "--bench-baseline" && i + 1 < argc) { benchBaseline = argv[++i]; }
+        else if (arg == "--fork-at" && i + 1 < argc) { forkAt = atoi(argv[++i]); }
+        else if (arg == "--warmup" && i + 1 < argc) { warmup = argv[++i]; }
+        else if (arg == "--snapshot" && i + 1 < argc) { snapshotPath = argv[++i]; }
+        else if (arg == "--restore" && i + 1 < argc) { restorePath = argv[++i]; }
+        else if (arg == "--trace" && i + 1 < argc) { tracePath = argv[++i]; }
+        else if (arg == "--counters" && i + 1 < argc) { countersPath = argv[++i]; }
+        else if (arg == "--counters-format" && i + 1 < argc) { countersFormat = argv[++i]; }
+        else if (arg == "--render" && i + 1 < argc) { renderPath = argv[++i]; }
+        else if (arg == "--render-format" && i + 1 < argc) { renderFormat = argv[++i]; }
+        else if (arg == "--convert" && i + 2 < argc) { return convertWorkload(argv[i + 1], argv[i + 2]) ? 0 : 1; }  // Convert a text workload and stop
+        else if (arg.compare(0, 2, "--") == 0) { cout << "Unknown option " << arg << endl; return 1; }
+        else { schedulers.push_back(arg); }  // Anything else is a scheduler type
+    }
+    if (summary != "" && summary != "json" && summary != "csv") { cout << "Invalid summary format " << summary << " (use json or csv)" << endl; return 1; }
+    if (countersFormat != "prometheus" && countersFormat != "json") { cout << "Invalid counters format " << countersFormat << " (use prometheus or json)" << endl; return 1; }
+#if SCHED_COUNTERS
+    counting = countersPath != "";
+#else
+    if (countersPath != "") { cout << "--counters needs a build with SCHED_COUNTERS on (it is compiled out with -DSCHED_COUNTERS=0)" << endl; return 1; }
+#endif
+    if (renderPath != "") { return renderTrace(renderPath.c_str(), renderFormat) ? 0 : 1; }  // Render a trace and stop
+    if (importConfig.unit < 1 || importConfig.split < 1) { cout << "Invalid import settings (need --import-unit >= 1 and --import-split >= 1)" << endl; return 1; }
+    if (importPath != "") { return importTrace(importPath, importOut, importConfig) ? 0 : 1; }  // Import a Linux scheduler trace and stop
+    MLFQConfig mlfq = makeMLFQConfig(levels > 0 ? levels : 3);  // Default is the original 3 levels with quanta 5 and 10
+    if (quanta != "") {  // Quanta given: one per level, and they set the number of levels if that was not given
+        mlfq.quanta = parseIntList(quanta);
+        if (levels == 0) { mlfq.levels = (int)mlfq.quanta.size(); }
+    }
+    mlfq.boostInterval = boost;
+    if (!validMLFQConfig(mlfq)) { return 1; }
+
+    if (policyConfig.rrQuantum < 1 || policyConfig.priorityLevels < 1 || policyConfig.priorityLevels > 64 || policyConfig.agingInterval < 0) { cout << "Invalid scheduler settings (need --rr-quantum >= 1, --priority-levels 1 to 64 and --aging >= 0)" << endl; return 1; }
+    if (policyConfig.cfsLatency < 1 || policyConfig.cfsGranularity < 1) { cout << "Invalid CFS settings (need --cfs-latency >= 1 and --cfs-granularity >= 1)" << endl; return 1; }
+    for (size_t i = 0; i < policyConfig.nice.size(); i++) { if (policyConfig.nice[i] < -20 || policyConfig.nice[i] > 19) { cout << "Invalid nice value " << policyConfig.nice[i] << " (use -20 to 19)" << endl; return 1; } }
+    for (size_t i = 0; i < policyConfig.tickets.size(); i++) { if (policyConfig.tickets[i] < 1) { cout << "Invalid ticket count " << policyConfig.tickets[i] << " (need at least 1)" << endl; return 1; } }
+    if (!parseBalance(balance, &smp.balance)) { return 1; }
+    if (smp.cpus < 1 || smp.balanceInterval < 1 || smp.migrationCost < 0) { cout << "Invalid SMP settings (need --cpus >= 1, --balance-interval >= 1 and --migration-cost >= 0)" << endl; return 1; }
+
+    if (generator.processes < 0 || generator.minBursts < 1 || generator.maxBursts < generator.minBursts) { cout << "Invalid generator settings (need --generate N >= 0 and --gen-bursts MIN:MAX with 1 <= MIN <= MAX)" << endl; return 1; }
+
+    if (streamPath != "" && (schedulers.size() != 1 || sweep || bench || generator.processes > 0 || workloadPath != "" || forkAt >= 0 || restorePath != "")) { cout << "--stream and --stream-trace need exactly one scheduler, and can not be used with --sweep, --bench, --generate, --workload, --fork-at or --restore" << endl; return 1; }  // A stream can only be read once
+    if ((snapshotPath != "" || warmup != "") && forkAt < 0) { cout << "--snapshot and --warmup need --fork-at" << endl; return 1; }
+    if (restorePath != "" && (forkAt >= 0 || sweep || bench)) { cout << "--restore can not be used with --fork-at, --sweep or --bench" << endl; return 1; }
+    Workload workload;  // Burst data shared by every simulation
+    if (generator.processes > 0) { }  // Generated processes don't need a workload
+    else if (streamPath != "") { if (!(streamTrace ? workload.openTrace(streamPath, importConfig) : workload.openStream(streamPath))) { return 1; } }  // Processes are read (or rebuilt from the trace) as they arrive
+    else if (workloadPath == "") { workload.useSample(); }  // Default is the 8 sample processes
+    else if (!workload.open(workloadPath)) { return 1; }
+
+    if (schedulers.empty()) { schedulers = { "SJF", "SRTF", "FCFS", "MLFQ" }; }  // Do four simulations by default, one for each scheduler
+    if (warmup == "") { warmup = schedulers[0]; }  // Warm up under the first scheduler unless told otherwise
+    if (forkAt >= 0 && !validScheduler(warmup)) { return 1; }
+    if (bench) {  // Benchmark every scheduler named (every scheduler by default) and stop
+        vector<int> sizes = parseIntList(benchSizes);
+        for (size_t i = 0; i < sizes.size(); i++) { if (sizes[i] < 1) { cout << "Invalid benchmark size " << sizes[i] << endl; return 1; } }
+        runBenchmarks(schedulers, sizes, mlfq, policyConfig, smp, workload, generator, benchOut, benchBaseline);
+        return 0;
+    }
+    if (sweep && tracePath != "") { cout << "--trace can not be used with --sweep" << endl; return 1; }
+    if (sweep) {  // Build the grid and run it in parallel
+        for (size_t i = 0; i < schedulers.size(); i++) { if (!validScheduler(schedulers[i])) { return 1; } }  // Check the schedulers once here rather than in every simulation
+        vector<MLFQConfig> quantaSets;  // MLFQ levels and quanta to try
+        if (sweepQuanta == "") { quantaSets.push_back(mlfq); }
+        for (size_t start = 0; sweepQuanta != "" && start <= sweepQuanta.size(); ) {  // Each '/' separated set gives its number of levels
+            size_t slash = sweepQuanta.find('/', start);
+            if (slash == string::npos) { slash = sweepQuanta.size(); }
+            vector<int> q = parseIntList(sweepQuanta.substr(start, slash - start));
+            MLFQConfig config = makeMLFQConfig((int)q.size());
+            config.quanta = q;
+            quantaSets.push_back(config);
+            start = slash + 1;
+        }
+        vector<int> boosts = sweepBoost == "" ? vector<int>(1, boost) : parseIntList(sweepBoost);  // Boost intervals to try
+        vector<MLFQConfig> mlfqs;  // Every combination of the two
+        for (size_t q = 0; q < quantaSets.size(); q++) {
+            for (size_t b = 0; b < boosts.size(); b++) {
+                mlfqs.push_back(quantaSets[q]);
+                mlfqs.back().boostInterval = boosts[b];
+                if (!validMLFQConfig(mlfqs.back())) { return 1; }
+            }
+        }
+        vector<SMPConfig> smps;  // CPU counts and balancing policies to try
+        vector<int> cpuCounts = sweepCPUs == "" ? vector<int>(1, smp.cpus) : parseIntList(sweepCPUs);
+        vector<BalancePolicy> policies(1, smp.balance);
+        if (sweepBalance != "") {  // Comma separated policy names
+            policies.clear();
+            for (size_t start = 0; start <= sweepBalance.size(); ) {
+                size_t comma = sweepBalance.find(',', start);
+                if (comma == string::npos) { comma = sweepBalance.size(); }
+                policies.push_back(BALANCE_GLOBAL);
+                if (!parseBalance(sweepBalance.substr(start, comma - start), &policies.back())) { return 1; }
+                start = comma + 1;
+            }
+        }
+        for (size_t c = 0; c < cpuCounts.size(); c++) {
+            if (cpuCounts[c] < 1) { cout << "Invalid CPU count " << cpuCounts[c] << endl; return 1; }
+            for (size_t b = 0; b < (cpuCounts[c] == 1 ? 1 : policies.size()); b++) {  // One CPU has nothing to balance
+                smps.push_back(smp);
+                smps.back().cpus = cpuCounts[c];
+                smps.back().balance = policies[b];
+            }
+        }
+        vector<uint64_t> seeds;  // Seeds to try
+        size_t dash = seedList.find('-');
+        if (seedList == "") { seeds.push_back(generator.seed); }
+        else if (dash != string::npos) { for (uint64_t seed = strtoull(seedList.c_str(), NULL, 10); seed <= strtoull(seedList.c_str() + dash + 1, NULL, 10); seed++) { seeds.push_back(seed); } }
+        else { vector<int> list = parseIntList(seedList);  seeds.assign(list.begin(), list.end()); }
+        runSweep(schedulers, mlfqs, policyConfig, smps, seeds, workload, generator, threads, forkAt, warmup, countersPath, countersFormat, scalar);
+        return 0;
+    }
+    Snapshot fork;  // Point every simulation carries on from (time -1 = none, so they start at t=0)
+    if (restorePath != "" && !fork.load(restorePath)) { return 1; }
+    if (forkAt >= 0) {  // Warm up once, with the same output level so PCBs are recycled (or kept) the same way as in the simulations that carry on
+        runSimulation(warmup, mlfq, policyConfig, smp, workload, generator, summary == "" ? output : OUTPUT_NONE, NULL, forkAt, &fork);
+        if (fork.time < 0 && summary == "") { cout << "Every process finished before time " << forkAt << " - simulating from t=0" << endl; }
+        if (fork.time >= 0 && snapshotPath != "" && !fork.save(snapshotPath)) { return 1; }
+    }
+    TraceWriter trace;  // Records of every simulation, if tracing
+    if (tracePath != "") {
+        if (!trace.open(tracePath.c_str())) { return 1; }
+        activeTrace = &trace;
+    }
+    vector<SimulationResult> results;  // Result of each simulation, for the counters
+    for (size_t i = 0; i < schedulers.size(); i++) {
+        if (summary == "") { results.push_back(runSimulation(schedulers[i], mlfq, policyConfig, smp, workload, generator, output, &fork)); continue; }
+        results.push_back(runSimulation(schedulers[i], mlfq, policyConfig, smp, workload, generator, OUTPUT_NONE, &fork));  // Nothing but the summary goes to stdout
+        printSummary(schedulers[i], results.back(), summary, i == 0);
+    }
+    if (summary == "json") { cout << "\n]" << endl; }
+#if SCHED_COUNTERS
+    vector<CounterLabels> labels;  // Scheduler and CPU count of each simulation
+    for (size_t i = 0; i < results.size(); i++) { labels.push_back(CounterLabels{ { "scheduler", schedulers[i] }, { "cpus", to_string(smp.cpus) } }); }
+    if (countersPath != "" && !writeCounters(countersPath, countersFormat, labels, results)) { return 1; }
+#endif
+    activeTrace = NULL;
+    trace.close();
+    return 0;
+}